@@ -0,0 +1,87 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERACCUMULATOR_H
+#define BASLERACCUMULATOR_H
+
+#include <vector>
+#include "BaslerCompatibility.h"
+
+namespace lima
+{
+  namespace Basler
+  {
+    /*******************************************************************
+     * \class Accumulator
+     * \brief sums raw frames into a 32 bits frame
+     *
+     * Raw frames (8 or 16 bits) are summed directly into the output
+     * buffer, one output frame every getNbFrames() raw frames. In Average
+     * mode the output frame is divided by the number of frames once
+     * complete. Optionally, per pixel statistics (mean, variance, min,
+     * max) are kept over all the raw frames of the run.
+     * It's not thread safe, the caller serializes add() and getRunMap().
+     *******************************************************************/
+    class LIBBASLER_API Accumulator
+    {
+    public:
+      enum Mode {Sum, Average};
+      enum RunMap {Mean, Variance, Min, Max};
+
+      Accumulator();
+
+      void setNbFrames(int nb_frames);
+      int getNbFrames() const {return m_nb_frames;}
+      void setMode(Mode mode) {m_mode = mode;}
+      Mode getMode() const {return m_mode;}
+      void setRunStatistics(bool active) {m_run_statistics = active;}
+      bool getRunStatistics() const {return m_run_statistics;}
+
+      // depth is the raw pixel size in bytes (1 or 2)
+      void prepare(int nb_pixels,int depth);
+      // returns true when dst holds a complete output frame
+      bool add(const void* raw,unsigned int* dst);
+      // only update the run statistics, if active
+      void addToRun(const void* raw);
+
+      int getNbPixels() const {return m_nb_pixels;}
+      long getNbRunFrames() const {return m_nb_run_frames;}
+      void getRunMap(RunMap map,double* values) const;
+
+    private:
+      template<class T> void _updateRun(const T* raw);
+
+      int				m_nb_frames;
+      Mode				m_mode;
+      bool				m_run_statistics;
+      int				m_nb_pixels;
+      int				m_depth;
+      int				m_frame_in_group;
+      long				m_nb_run_frames;
+      std::vector<unsigned long long>	m_run_sum;
+      std::vector<unsigned long long>	m_run_sum2;
+      std::vector<unsigned short>	m_run_min;
+      std::vector<unsigned short>	m_run_max;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERACCUMULATOR_H
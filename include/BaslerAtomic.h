@@ -0,0 +1,160 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERATOMIC_H
+#define BASLERATOMIC_H
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+namespace lima
+{
+  namespace Basler
+  {
+    // 64 bits counters shared between threads or processes, the read-
+    // modify-writes are full memory barriers. atomicStore is only a
+    // release, a plain store on x86: a load following it may be done
+    // before it. atomicLoad doesn't write, so it can be used on a
+    // read-only mapping, it's only an acquire: reads made before it may
+    // still be done after it. A seqlock writer calls atomicWriteFence()
+    // between writing the odd sequence and the data, a reader calls
+    // atomicReadFence() between reading the data and reading the
+    // sequence again.
+#ifdef WIN32
+    typedef volatile LONGLONG AtomicCounter;
+
+    inline unsigned long long atomicLoad(const AtomicCounter* p)
+    {
+      MemoryBarrier();
+      LONGLONG value = *p;
+      MemoryBarrier();
+      return (unsigned long long)value;
+    }
+
+    inline void atomicStore(AtomicCounter* p,unsigned long long value)
+    {
+      MemoryBarrier();
+      *p = LONGLONG(value);
+    }
+
+    inline unsigned long long atomicAdd(AtomicCounter* p,unsigned long long value)
+    {
+      LONGLONG old = *p;
+      LONGLONG prev;
+      while((prev = InterlockedCompareExchange64(p,old + LONGLONG(value),old)) != old)
+	old = prev;
+      return (unsigned long long)(old + LONGLONG(value));
+    }
+
+    // return the previous value
+    inline unsigned long long atomicExchange(AtomicCounter* p,unsigned long long value)
+    {
+      return (unsigned long long)InterlockedExchange64(p,LONGLONG(value));
+    }
+
+    inline unsigned long long atomicOr(AtomicCounter* p,unsigned long long value)
+    {
+      LONGLONG old = *p;
+      LONGLONG prev;
+      while((prev = InterlockedCompareExchange64(p,old | LONGLONG(value),old)) != old)
+	old = prev;
+      return (unsigned long long)old;
+    }
+
+    inline void atomicReadFence()
+    {
+      MemoryBarrier();
+    }
+
+    inline void atomicWriteFence()
+    {
+      MemoryBarrier();
+    }
+#else
+    typedef volatile unsigned long long AtomicCounter;
+
+    inline unsigned long long atomicLoad(const AtomicCounter* p)
+    {
+#ifdef __ATOMIC_SEQ_CST
+      return __atomic_load_n(p,__ATOMIC_SEQ_CST);
+#else
+      __sync_synchronize();
+      unsigned long long value = *p;
+      __sync_synchronize();
+      return value;
+#endif
+    }
+
+    inline void atomicStore(AtomicCounter* p,unsigned long long value)
+    {
+#ifdef __ATOMIC_RELEASE
+      __atomic_store_n(p,value,__ATOMIC_RELEASE);
+#else
+      __sync_synchronize();
+      *p = value;
+#endif
+    }
+
+    inline unsigned long long atomicAdd(AtomicCounter* p,unsigned long long value)
+    {
+      return __sync_add_and_fetch(p,value);
+    }
+
+    // return the previous value
+    inline unsigned long long atomicExchange(AtomicCounter* p,unsigned long long value)
+    {
+      unsigned long long old = *p;
+      unsigned long long prev;
+      while((prev = __sync_val_compare_and_swap(p,old,value)) != old)
+	old = prev;
+      return old;
+    }
+
+    inline unsigned long long atomicOr(AtomicCounter* p,unsigned long long value)
+    {
+      return __sync_fetch_and_or(p,value);
+    }
+
+    // the reads before can't be moved after the reads following it
+    inline void atomicReadFence()
+    {
+#ifdef __ATOMIC_ACQUIRE
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#else
+      __sync_synchronize();
+#endif
+    }
+
+    // the writes after can't be moved before the writes preceding it
+    inline void atomicWriteFence()
+    {
+#ifdef __ATOMIC_RELEASE
+      __atomic_thread_fence(__ATOMIC_RELEASE);
+#else
+      __sync_synchronize();
+#endif
+    }
+#endif
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERATOMIC_H
@@ -0,0 +1,96 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERBEAMMONITOR_H
+#define BASLERBEAMMONITOR_H
+
+#include <vector>
+#include "BaslerCompatibility.h"
+
+namespace lima
+{
+  namespace Basler
+  {
+    /*******************************************************************
+     * \class BeamMonitor
+     * \brief per ROI beam statistics of each raw frame
+     *
+     * For each ROI the sum, the max, the centroid and the FWHM of the
+     * horizontal and vertical profiles are computed in one pass over the
+     * pixels. Results are kept in a ring of the last getHistorySize()
+     * frames, read back by frame number.
+     * It's not thread safe, the caller serializes process() and read().
+     *******************************************************************/
+    class LIBBASLER_API BeamMonitor
+    {
+    public:
+      struct Roi
+      {
+	int x,y,width,height;
+      };
+
+      struct Stats
+      {
+	long	frame_nb;
+	double	timestamp;
+	int	roi_index;
+	double	sum;
+	double	max;
+	double	centroid_x;
+	double	centroid_y;
+	double	fwhm_x;
+	double	fwhm_y;
+      };
+
+      BeamMonitor();
+
+      void setRois(const std::vector<Roi>& rois);
+      const std::vector<Roi>& getRois() const {return m_rois;}
+      void setHistorySize(int nb_frames);
+      int getHistorySize() const {return m_history_size;}
+
+      // depth is the raw pixel size in bytes (1 or 2), clears the history
+      void prepare(int width,int height,int depth);
+      void process(const void* frame,double timestamp);
+
+      long getNbFrames() const {return m_nb_frames;}
+      // statistics of the frames >= from_frame still in the history
+      void read(long from_frame,std::vector<Stats>& stats) const;
+
+    private:
+      template<class T> void _process(const T* frame,const Roi& roi,Stats& stats);
+      static double _fwhm(const std::vector<double>& profile);
+
+      std::vector<Roi>		m_rois;
+      int			m_history_size;
+      int			m_width;
+      int			m_height;
+      int			m_depth;
+      long			m_nb_frames;
+      std::vector<Stats>	m_history;
+      std::vector<unsigned int>	m_profile_x;
+      std::vector<double>	m_profile_y;
+      std::vector<double>	m_profile;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERBEAMMONITOR_H
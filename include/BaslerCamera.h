@@ -31,13 +31,34 @@
 #include <pylon/gige/BaslerGigEDeviceInfo.h>
 #include <stdlib.h>
 #include <limits>
+#include <deque>
+#include <map>
 #include "lima/HwMaxImageSizeCallback.h"
 #include "lima/HwBufferMgr.h"
 #include "BaslerCompatibility.h"
+#include "BaslerLatencyHistogram.h"
+#include "BaslerAccumulator.h"
+#include "BaslerCorrection.h"
+#include "BaslerWorkerPool.h"
+#include "BaslerBeamMonitor.h"
+#include "BaslerCompression.h"
+#include "BaslerRawWriter.h"
+#include "BaslerShmRing.h"
+#include "BaslerTraceRing.h"
+#include "BaslerNotifier.h"
+#include "BaslerPreview.h"
+#include "BaslerAtomic.h"
+#include "processlib/Data.h"
 
 using namespace Pylon;
 using namespace std;
 
+// The transport layer (GigE or USB3 Vision) is selected at runtime from the
+// device found. The GigE camera parameter classes are bound by feature name,
+// they only give access to the features both transports name the same. The
+// others are resolved by name at open, GigE only ones are checked with
+// IsReadable/IsWritable. The stream grabber is the generic IStreamGrabber,
+// its parameters are set by name as they differ between the transports.
 #if defined( USE_1394 )
 // Settings to use  Basler 1394 cameras
 #include <pylon/1394/Basler1394Camera.h>
@@ -45,14 +66,12 @@ typedef Pylon::CBasler1394Camera Camera_t;
 using namespace Basler_IIDC1394CameraParams;
 using namespace Basler_IIDC1394StreamParams;
 
-#elif defined ( USE_GIGE )
-// settings to use Basler GigE cameras
+#else
+// settings to use Basler GigE and USB3 Vision cameras
 #include <pylon/gige/BaslerGigECamera.h>
 typedef Pylon::CBaslerGigECamera Camera_t;
 using namespace Basler_GigECameraParams;
 using namespace Basler_GigEStreamParams;
-#else
-#error Camera type is not specified. For example, define USE_GIGE for using GigE cameras
 #endif
 
 
@@ -67,7 +86,7 @@ namespace Basler
  * \brief object controlling the basler camera via Pylon driver
  *******************************************************************/
 class VideoCtrlObj;
-class LIBBASLER_API Camera
+class LIBBASLER_API Camera : public HwMaxImageSizeCallbackGen
 {
     DEB_CLASS_NAMESPC(DebModCamera, "Camera", "Basler");
     friend class Interface;
@@ -79,9 +98,97 @@ class LIBBASLER_API Camera
       Ready, Exposure, Readout, Latency, Fault
     };
 
-    Camera(const std::string& camera_ip,int packet_size = -1,int received_priority = 0);
+    enum Transport {
+      GigE, Usb
+    };
+
+    struct StreamStatistics
+    {
+      long	total_buffer_count;
+      long	failed_buffer_count;
+      long	buffer_underrun_count;
+      long	total_packet_count;
+      long	lost_packet_count;
+      long	resent_packet_count;
+      long	resend_request_count;
+      long	resynchronization_count;
+      long	last_error_code;
+      double	bandwidth;		// achieved, in bytes/s
+      double	timestamp;		// time of the last sample
+      // stream grabber parameters in effect, -1 if not available
+      long	socket_buffer_size;	// KB
+      long	resend_timeout;		// ms
+      long	resend_request_threshold;	// % of the receive window
+      long	receive_window_size;	// packets
+      long	packet_timeout;		// ms
+      long	frame_retention;	// ms
+      long	max_transfer_size;	// bytes, USB only
+      long	nb_max_queued_urbs;	// USB only
+    };
+    static const int NB_STREAM_PARAMETERS = 8;
+
+    // frame latency stages: camera timestamp -> RetrieveResult (Transfer)
+    // -> QueueBuffer (Requeue) -> return from newFrameReady (Delivery)
+    enum LatencyStage {
+      Transfer, Requeue, Delivery, Total
+    };
+    static const int NB_LATENCY_STAGE = Total + 1;
+
+    // scheduling policy of the acquisition thread
+    enum ThreadPolicy {
+      SchedOther, SchedFifo, SchedRR
+    };
+
+    // live mode (nb frames == 0) grab strategy, LatestImageOnly copies
+    // the newest frame in the Lima buffer and is ignored when accumulating,
+    // with the run statistics, the beam monitor or a color camera
+    enum LiveGrabStrategy {
+      OneByOne, LatestImageOnly
+    };
+
+    enum AccumulationMode {
+      AccumulationSum, AccumulationAverage
+    };
+
+    // per pixel maps over all the frames of the run
+    enum RunMap {
+      RunMean, RunVariance, RunMin, RunMax
+    };
+
+    struct LatencyStatistics
+    {
+      long	count;
+      double	min;
+      double	max;
+      double	mean;
+      double	p50;
+      double	p90;
+      double	p99;
+      double	p999;
+    };
+
+    struct RawStreamStatistics
+    {
+      long	nb_frames;
+      double	throughput;		// MB/s
+      int	queue_depth;
+      int	max_queue_depth;
+    };
+
+    // camera_id is an IP address or DNS name (GigE), a serial number
+    // or a user defined name (any transport)
+    Camera(const std::string& camera_id,int packet_size = -1,int received_priority = 0,
+	   bool lazy_open = false);
     ~Camera();
 
+    // -- deferred open, see lazy_open. Until the camera is opened,
+    // the methods talking to it throw, during the open they wait for it.
+    void open();
+    void openAsync();
+    void waitOpened();
+    void isOpened(bool& opened) const;
+    void getStartupTime(double& resolve,double& create,double& configure) const;
+
     void prepareAcq();
     void startAcq();
     void stopAcq();
@@ -118,6 +225,14 @@ class LIBBASLER_API Camera
     void setRoi(const Roi& set_roi);
     void getRoi(Roi& hw_roi);    
 
+    // -- offset only roi change during an acquisition, when the model
+    // supports it (setRoi outside an acquisition). getRoiOffset gives
+    // the offsets in effect for a frame, from the camera timestamp of
+    // the frame when the camera clock can be latched, else from the
+    // first frame retrieved after the move.
+    void moveRoi(int x,int y);
+    void getRoiOffset(long frame_nb,int& x,int& y);
+
     void checkBin(Bin&);
     void setBin(const Bin&);
     void getBin(Bin&);
@@ -127,6 +242,123 @@ class LIBBASLER_API Camera
 
     void setFrameTransmissionDelay(int ftd);
 
+    void setLiveGrabStrategy(LiveGrabStrategy strategy);
+    void getLiveGrabStrategy(LiveGrabStrategy& strategy) const;
+    void getNbSkippedFrames(long& nb_skipped_frames) const;
+
+    // -- frame accumulation, nb_frames raw frames give one 32 bits frame
+    void setAccumulation(int nb_frames,AccumulationMode mode = AccumulationSum);
+    void getAccumulation(int& nb_frames,AccumulationMode& mode) const;
+    void setRunStatistics(bool active);
+    void getRunStatistics(bool& active) const;
+    void getRunStatisticsMap(RunMap map,Data& data);
+
+    // -- dark, flat-field and defective pixel correction, tables are
+    // images of the current size and can be loaded while running.
+    // An empty Data clears the table.
+    void setCorrectionDark(const Data& dark);
+    void setCorrectionFlat(const Data& flat);
+    void setCorrectionDefects(const Data& defects);
+    void resetCorrection();
+    void setCorrectionActive(bool active);
+    void getCorrectionActive(bool& active) const;
+    void setProcessingThreads(int nb_threads);
+    void getProcessingThreads(int& nb_threads) const;
+
+    // -- per ROI beam statistics of each raw frame, ROIs are given
+    // in the image coordinates. readBeamStatistics returns a double
+    // image of NB_BEAM_VALUES columns, one line per frame and ROI.
+    enum BeamValue {BeamFrame, BeamTimestamp, BeamRoi, BeamSum, BeamMax,
+		    BeamCentroidX, BeamCentroidY, BeamFwhmX, BeamFwhmY,
+		    NB_BEAM_VALUES};
+    void addBeamMonitorRoi(const Roi& roi);
+    void resetBeamMonitorRois();
+    void getBeamMonitorNbRois(int& nb_rois) const;
+    void setBeamMonitorActive(bool active);
+    void getBeamMonitorActive(bool& active) const;
+    void setBeamMonitorStoreFrames(bool store);
+    void getBeamMonitorStoreFrames(bool& store) const;
+    void setBeamMonitorHistory(int nb_frames);
+    void getBeamMonitorHistory(int& nb_frames) const;
+    void readBeamStatistics(long from_frame,Data& data);
+
+    // -- ring of LZ4 compressed frames kept in memory, size in MB
+    // (0 disables it), frames are decompressed when read.
+    void setCompressionBufferSize(int size);
+    void getCompressionBufferSize(int& size) const;
+    void getCompressedFrames(long& first_frame,long& nb_frames);
+    void getCompressionRatio(double& ratio);
+    void readCompressedFrame(long frame_nb,Data& data);
+
+    // -- raw streaming, grabbed frames are written to filename instead
+    // of being delivered to Lima, an empty filename disables it.
+    void setRawStreamFile(const std::string& filename);
+    void getRawStreamFile(std::string& filename) const;
+    void setRawStreamBuffers(int nb_buffers);
+    void getRawStreamBuffers(int& nb_buffers) const;
+    void getRawStreamStatistics(RawStreamStatistics& stats);
+
+    // -- delivered frames are also published in the POSIX shared memory
+    // name (e.g. "/lima_basler"), an empty name disables it.
+    void setShmRing(const std::string& name,int nb_slots);
+    void getShmRing(std::string& name,int& nb_slots) const;
+    void getShmRingPublished(long& nb_frames) const;
+
+    // -- pinned frames, for zero copy views of the Lima buffers (color
+    // buffers in video mode). Only a buffer out of the grab queue can be
+    // pinned, it's not written again until it's unpinned with the address
+    // given by pinFrame. isFrameValid tells if a frame can be pinned.
+    // frame_nb -1 is the last frame, channels is 0 for packed YUV
+    // (width is then the size in bytes and height 1).
+    void pinFrame(long frame_nb,unsigned long long& address,int& width,int& height,
+		  int& depth,int& channels,long& pinned_frame_nb);
+    void unpinFrame(unsigned long long address);
+    void getNbPinnedFrames(int& nb_frames) const;
+    bool isFrameValid(long frame_nb) const;
+
+    // -- blocking waits, for the Python asynchronous API (the GIL is
+    // released). A negative timeout waits forever.
+    // waitFrame returns true once frame_nb is acquired, false on timeout
+    // or if the acquisition ends before, last_frame is the last acquired frame.
+    // Both can be called as soon as prepareAcq is done, before startAcq.
+    bool waitFrame(long frame_nb,double timeout,long& last_frame);
+    // waitAcqEnd returns true once the acquisition is finished
+    bool waitAcqEnd(double timeout);
+
+    // -- binary ring of the acquisition events, recorded without
+    // formatting nor lock so it can stay on in production (compiled out
+    // with BASLER_NO_TRACE), 0 events disables it. readTraceEvents
+    // returns a double image of 4 columns (timestamp, frame, event, arg),
+    // one line per event, dumpTraceEvents writes them as text.
+    enum TraceEvent {TraceAcqStart, TraceAcqEnd, TraceFrameRetrieved,
+		     TraceFrameDelivered, TraceFrameFailed, TraceStatus,
+		     TraceTimeout};
+    void setTraceRingSize(int nb_events);
+    void getTraceRingSize(int& nb_events) const;
+    void readTraceEvents(Data& data);
+    void dumpTraceEvents(const std::string& filename);
+
+    // -- notification of the frame arrival, acquisition end and fault,
+    // coalesced while not consumed. getNotifyFd is an eventfd (Linux,
+    // -1 otherwise) readable while events are pending, readNotifyEvents
+    // clears it and returns them. The callbacks are called from a
+    // dedicated thread with the events since their previous call.
+    enum NotifyEvent {NotifyFrame = 1, NotifyAcqEnd = 2, NotifyFault = 4};
+    int getNotifyFd() const;
+    int readNotifyEvents();
+    void registerNotifyCallback(NotifyCallback& cb);
+    void unregisterNotifyCallback(NotifyCallback& cb);
+
+    // -- preview tap, at most one frame per interval (in s, 0 disables
+    // it) subsampled by factor, next to the acquisition in any mode.
+    // getPreviewFrame returns the last one (frameNumber -1 if none yet),
+    // color frames as channels x width x height, YUV ones aren't previewed.
+    void setPreviewInterval(double interval);
+    void getPreviewInterval(double& interval) const;
+    void setPreviewDownsampling(int factor);
+    void getPreviewDownsampling(int& factor) const;
+    void getPreviewFrame(Data& data);
+
     // -- basler specific, LIMA don't worry about it !
     void getFrameRate(double& frame_rate) const;
     bool isBinningAvailable() const;
@@ -134,6 +366,40 @@ class LIBBASLER_API Camera
     void setTimeout(int TO);
     void reset();
 
+    // -- acquisition watchdog
+    void setWatchdogMissedFrames(int nb_frames);
+    void getWatchdogMissedFrames(int& nb_frames) const;
+    void setExtTrigTimeout(double timeout);
+    void getExtTrigTimeout(double& timeout) const;
+    void setHeartbeatPeriod(double period);
+    void getHeartbeatPeriod(double& period) const;
+    void getWatchdogTimeout(int& timeout) const;
+
+    // -- camera loss recovery
+    void setAutoReconnect(bool flag);
+    void getAutoReconnect(bool& flag) const;
+    void setAutoResume(bool flag);
+    void getAutoResume(bool& flag) const;
+    void setReconnectTimeout(double timeout);
+    void getReconnectTimeout(double& timeout) const;
+    void reconnect();
+
+    // -- configuration snapshots
+    void saveUserSet(int user_set);
+    void loadUserSet(int user_set);
+    void setDefaultUserSet(int user_set);
+    void saveFeatureFile(const std::string& filename);
+    void loadFeatureFile(const std::string& filename);
+
+    // -- threads affinity and scheduling, cpu list as "0,2,4-7"
+    void setAcqThreadAffinity(const std::string& cpu_list);
+    void setAcqThreadScheduling(ThreadPolicy policy,int priority);
+    void getAcqThreadSettings(std::string& cpu_list,ThreadPolicy& policy,
+			      int& priority) const;
+    void setReceiveThreadAffinity(const std::string& cpu_list);
+    void setReceiveThreadPriority(int priority);
+    void getReceiveThreadSettings(std::string& cpu_list,int& priority) const;
+
     void setGain(double gain);
     void getGain(double& gain) const;
 
@@ -146,46 +412,297 @@ class LIBBASLER_API Camera
     // -- Pylon buffers statistics
     void getStatisticsTotalBufferCount(long& count);    
     void getStatisticsFailedBufferCount(long& count);
+    void getStreamStatistics(StreamStatistics& stats);
+    void setStreamStatisticsPeriod(double period);
+    void getStreamStatisticsPeriod(double& period) const;
+
+    // -- stream grabber tuning: "default","low-latency",
+    // "lossless-high-throughput","many-cameras", persisted per camera,
+    // or once made for the camera "auto-tuned" and "custom"
+    void setStreamProfile(const std::string& name);
+    void getStreamProfile(std::string& name) const;
+    void setUsbStreamParameters(int max_transfer_size,int nb_max_queued_urbs);
+    void getTransport(Transport& transport) const;
+
+    // -- sweep packet size, inter-packet delay and socket buffer size with
+    // the current ROI and pixel format, keep the fastest lossless setting
+    // as the "auto-tuned" profile and write a report.
+    void autoTuneTransport(const std::string& report_file,double point_duration = 2.);
+
+    // -- frame latency histograms
+    void getLatencyStatistics(LatencyStage stage,LatencyStatistics& stats) const;
+    const LatencyHistogram& getLatencyHistogram(LatencyStage stage) const;
     
  private:
     class _AcqThread;
     friend class _AcqThread;
+    class _OpenThread;
+    friend class _OpenThread;
+    struct _Config;
+    class _FrameBufferCtrlObj : public SoftBufferCtrlObj
+    {
+    public:
+      _FrameBufferCtrlObj(Camera& cam) : m_cam(cam) {}
+      virtual void setFrameDim(const FrameDim& frame_dim);
+      virtual void setNbBuffers(int nb_buffers);
+    private:
+      Camera&	m_cam;
+    };
+    struct _ColorFrame
+    {
+      void*	ptr;
+      int	width;
+      int	height;
+      VideoMode	mode;
+      long	frame_nb;
+      int	buffer;
+    };
+    class _RawWriteCallback : public RawWriter::Callback
+    {
+    public:
+      _RawWriteCallback(Camera& cam) : m_cam(cam) {}
+      virtual void framesWritten();
+    private:
+      Camera&	m_cam;
+    };
     void _stopAcq(bool);
     void _setStatus(Camera::Status status,bool force);
     void _freeStreamGrabber();
     void _initColorStreamGrabber(bool = false);
+    void _freeColorBuffers();
+    void _resetStreamStatistics();
+    void _sampleStreamStatistics();
+    void _applyStreamParameters();
+    void _loadStreamProfile();
+    void _saveStreamProfile(const std::string& name);
+    std::string _getStreamProfileFile() const;
+    void _findDevice(CDeviceInfo& device_info);
+    void _resolveFeatures();
+    bool _selectAcquisitionStartTrigger();
+    void _measureTransport(double duration,double& fps,long& failed_buffers,
+			   long& lost_packets,long& resend_requests);
+    void _setLastErrorCode(long error_code);
+    void _latchCameraClock();
+    bool _readCameraTick(unsigned long long& tick);
+    void _resetRoiMoves();
+    void _checkRoiOffsets(int x,int y,int width,int height);
+    void _confirmRoiMoves(const GrabResult& result);
+    void _recordLatency(const GrabResult&,double retrieve_time,
+			double queue_time,double delivered_time);
+    void _retrieveLatestResult(GrabResult&);
+    bool _isLatestImageOnly() const;
+    void _computeWatchdogTimeout();
+    bool _checkDevice();
+    void _checkCamera() const;
+    void _getRawImageType(ImageType& type);
+    void _allocRawBuffers(int nb_buffers);
+    void _freeRawBuffers();
+    bool _processFrame(const GrabResult& result,void* dst,double retrieve_time);
+    double _getFrameTimestamp(const GrabResult& result,double retrieve_time) const;
+    void _streamFrame(const GrabResult& result,double retrieve_time);
+    void _previewColorFrame(const GrabResult& result,VideoMode mode,double retrieve_time);
+    void _requeueWrittenBuffers();
+    void _checkNoPinnedFrame();
+    void _setAcqPending(bool pending);
+    bool _isFrameValid(long frame_nb) const;
+    void _holdColorFrame(const GrabResult& result,VideoMode mode);
+    void _queueColorBuffer(int buffer);
+    void _publishImageNumber();
+    Camera::Status _getStatus() const {return Camera::Status(atomicLoad(&m_status));}
+    long _getNbAcquiredFrames() const {return long(atomicLoad(&m_nb_acquired_frames));}
+    void _getCorrection(Correction& correction);
+    void _setCorrection(Correction& correction);
+    void _initStreamGrabber(int first_buffer,int nb_queued);
+    void _registerRemovalCallback();
+    void _removalCallback(IPylonDevice*);
+    void _saveConfig();
+    void _syncConfig(const _Config& prev_config);
+    void _checkNotRunning();
+    void _selectUserSet(int user_set,bool writable);
+    void _checkThreadSettings();
+    void _applyAcqThreadSettings();
+    void _setReceiveThreadPriority();
+    void _applyConfig();
+    void _releaseDevice();
+    void _reconnect(bool resume);
+    bool _recoverDevice(WaitObjects&);
 
-    static const int NB_COLOR_BUFFER = 2;
+    // the buffer of the last frame is kept out of the grab queue
+    static const int NB_COLOR_BUFFER = 4;
     //- lima stuff
-    SoftBufferCtrlObj		m_buffer_ctrl_obj;
+    _FrameBufferCtrlObj		m_buffer_ctrl_obj;
     int                         m_nb_frames;    
-    Camera::Status              m_status;
+    // status and acquired frames are read lock-free by the pollers,
+    // m_image_number is owned by the acquisition thread
+    AtomicCounter               m_status;
     volatile bool               m_wait_flag;
     volatile bool               m_quit;
     volatile bool               m_thread_running;
     int                         m_image_number;
+    AtomicCounter               m_nb_acquired_frames;
+    AtomicCounter               m_nb_frame_waiters;
+    // from prepareAcq to the end of the acquisition, under m_frame_cond mutex
+    bool                        m_acq_pending;
     double                      m_exp_time;
     int                         m_timeout;
+    TrigMode                    m_trig_mode;
+    int                         m_watchdog_missed_frames;
+    double                      m_ext_trig_timeout;
+    double                      m_heartbeat_period;
+    int                         m_watchdog_timeout;
     double                      m_latency_time;
+    LiveGrabStrategy            m_live_grab_strategy;
+    AtomicCounter               m_skipped_frames;
     
     //- basler stuff 
-    string                      m_camera_ip;
+    string                      m_camera_id;
+    Transport                   m_transport;
+    // features named differently by GigE and USB3 Vision cameras
+    GenApi::CFloatPtr           m_exposure_time_node;
+    GenApi::CFloatPtr           m_frame_rate_node;
+    GenApi::CFloatPtr           m_resulting_frame_rate_node;
+    GenApi::CFloatPtr           m_gain_node;
+    GenApi::CIntegerPtr         m_heartbeat_node;
     string                      m_detector_model;
     string                      m_detector_type;
     Size                        m_detector_size;
     
+    //- last committed configuration, reapplied on reconnection
+    struct _Config
+    {
+      bool	valid;
+      int64_t	pixel_format;
+      Roi	roi;
+      int	bin_x;
+      int	bin_y;
+      int	packet_size;
+      int	inter_packet_delay;
+      int	frame_transmission_delay;
+      int	gain_raw;
+      double	gain;		// USB cameras, no GainRaw
+      bool	auto_gain;
+      bool	auto_exposure;
+    };
+    _Config                     m_config;
+    bool                        m_auto_reconnect;
+    bool                        m_auto_resume;
+    double                      m_reconnect_timeout;
+    volatile bool               m_device_removed;
+
     //- Pylon stuff
     DeviceInfoList_t              devices_;
+    CDeviceInfo                   m_device_info;
+    DeviceCallbackHandle          m_removal_cb_handle;
+    // held around the Camera_ and StreamGrabber_ uses of the control
+    // calls, so they don't run while the device is swapped
+    mutable Mutex                 m_device_lock;
     Camera_t*                     Camera_;
-    Camera_t::StreamGrabber_t*    StreamGrabber_;
+    IStreamGrabber*               StreamGrabber_;
     WaitObjectEx                  WaitObject_;
     size_t                        ImageSize_;
     _AcqThread*                   m_acq_thread;
+    _OpenThread*                  m_open_thread;
+    bool                          m_opened;
+    string                        m_open_error;
+    struct
+    {
+      double resolve;
+      double create;
+      double configure;
+    }                             m_startup_time;
     Cond                          m_cond;
+    Cond                          m_frame_cond;
     int                           m_receive_priority;
+    string                        m_receive_affinity;
+    int                           m_effective_receive_priority;
+    string                        m_acq_thread_affinity;
+    ThreadPolicy                  m_acq_thread_policy;
+    int                           m_acq_thread_priority;
+    volatile bool                 m_acq_thread_settings_changed;
+    string                        m_effective_acq_thread_affinity;
+    ThreadPolicy                  m_effective_acq_thread_policy;
+    int                           m_effective_acq_thread_priority;
+    int                           m_packet_size;
     bool			  m_color_flag;
     void*			  m_color_buffer[NB_COLOR_BUFFER];
+    StreamBufferHandle		  m_color_handles[NB_COLOR_BUFFER];
+    bool			  m_color_queued[NB_COLOR_BUFFER];
+    int				  m_color_pins[NB_COLOR_BUFFER];
+    long			  m_color_buffer_frames[NB_COLOR_BUFFER];	// frame in each buffer
+    int				  m_color_last;
+    _ColorFrame			  m_color_frames[NB_COLOR_BUFFER];
+    int				  m_nb_pinned_frames;
+    std::map<unsigned long long,int> m_frame_pins;	// Lima buffer address -> pins
     VideoCtrlObj*		  m_video;
+    bool			  m_interface_created;
+
+    //- stream statistics
+    mutable Mutex		  m_stats_lock;
+    StreamStatistics		  m_stream_stats;
+    double			  m_stats_period;
+    Timestamp			  m_stats_start;
+    double			  m_stats_sample_time;	// acquisition thread copy
+    string			  m_stream_profile;
+    long			  m_stream_params[NB_STREAM_PARAMETERS];
+    long			  m_effective_stream_params[NB_STREAM_PARAMETERS];
+    // profiles made for this camera, saved in its config file
+    std::map<std::string,std::vector<long> > m_camera_stream_profiles;
+    int				  m_tuned_packet_size;
+    int				  m_tuned_inter_packet_delay;
+
+    //- frame latency
+    LatencyHistogram		  m_latency[NB_LATENCY_STAGE];
+    double			  m_cam_tick_period;
+    double			  m_cam_time_offset;
+
+    //- processing path, frames are grabbed in the raw buffers
+    //- and processed into the Lima buffers
+    Mutex			  m_process_lock;
+    Accumulator			  m_accumulator;
+    Correction			  m_correction;
+    bool			  m_correction_active;
+    WorkerPool			  m_worker_pool;
+    Size			  m_process_size;
+    int				  m_process_depth;
+    int				  m_process_max_value;
+    BeamMonitor			  m_beam_monitor;
+    bool			  m_beam_monitor_active;
+    bool			  m_beam_store_frames;
+    CompressedRing		  m_compressed_ring;
+    //- raw streaming, buffers are queued back once written
+    RawWriter			  m_raw_writer;
+    std::string			  m_raw_stream_file;
+    int				  m_raw_stream_buffers;
+    WaitObjectEx		  m_raw_write_done;
+    _RawWriteCallback		  m_raw_write_callback;
+    //- shared memory ring for external readers
+    ShmRing			  m_shm_ring;
+    std::string			  m_shm_name;
+    int				  m_shm_nb_slots;
+    //- acquisition events
+    TraceRing			  m_trace_ring;
+    Notifier			  m_notifier;
+    //- decimated preview
+    Preview			  m_preview;
+    //- live roi moves, written but not seen in a frame yet and the
+    //- offsets in effect by first frame
+    struct _RoiMove
+    {
+      unsigned long long tick;	// camera clock after the write, 0 if unknown
+      int x;
+      int y;
+    };
+    struct _RoiOffset
+    {
+      long first_frame;
+      int x;
+      int y;
+    };
+    Mutex			  m_roi_lock;
+    std::deque<_RoiMove>	  m_roi_moves;
+    std::deque<_RoiOffset>	  m_roi_offsets;
+    volatile bool		  m_roi_move_pending;
+    std::vector<void*>		  m_raw_buffers;
 };
 } // namespace Basler
 } // namespace lima
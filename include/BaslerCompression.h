@@ -0,0 +1,110 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERCOMPRESSION_H
+#define BASLERCOMPRESSION_H
+
+#include <deque>
+#include <vector>
+#include "BaslerCompatibility.h"
+#include "BaslerWorkerPool.h"
+
+namespace lima
+{
+  namespace Basler
+  {
+    /*******************************************************************
+     * \class CompressedRing
+     * \brief ring of compressed frames in a preallocated arena
+     *
+     * Frames are cut in blocks of BLOCK_SIZE pixels, each block is
+     * bitshuffled (bit planes) and LZ4 compressed, the blocks being
+     * shared between the threads of a WorkerPool. The oldest frames are
+     * dropped when the arena is full. A compressed frame is self
+     * described, it's copied out with get() and decompressed later.
+     * It's not thread safe, the caller serializes add() and get().
+     *******************************************************************/
+    class LIBBASLER_API CompressedRing
+    {
+    public:
+      enum {BLOCK_SIZE = 8192};
+
+      struct Header
+      {
+	unsigned int width;
+	unsigned int height;
+	unsigned int depth;
+	unsigned int nb_blocks;
+      };
+
+      CompressedRing();
+      ~CompressedRing();
+
+      // false if the library was built without LZ4
+      static bool isAvailable();
+
+      // arena size in bytes, 0 frees it
+      void setSize(size_t size);
+      size_t getSize() const {return m_size;}
+
+      // depth is the pixel size in bytes (1, 2 or 4), clears the ring
+      void prepare(int width,int height,int depth);
+      // returns false if the compressed frame doesn't fit in the arena
+      bool add(long frame_nb,const void* frame,WorkerPool& pool);
+
+      long getFirstFrame() const;
+      long getNbFrames() const {return long(m_entries.size());}
+      double getRatio() const;
+
+      // copy of a compressed frame, false if it's not in the ring
+      bool get(long frame_nb,std::vector<char>& compressed) const;
+      static const Header& getHeader(const std::vector<char>& compressed);
+      // dst holds width * height * depth bytes
+      static void decompress(const std::vector<char>& compressed,void* dst);
+
+    private:
+      class _CompressTask;
+      friend class _CompressTask;
+
+      struct Entry
+      {
+	long	frame_nb;
+	size_t	offset;
+	size_t	size;
+      };
+
+      void _clear();
+      void _compressBlocks(const char* frame,int first_block,int last_block,int part);
+
+      char*				m_arena;
+      size_t				m_size;
+      size_t				m_head;
+      size_t				m_stored;
+      std::deque<Entry>			m_entries;
+      Header				m_header;
+      std::vector<unsigned int>		m_block_sizes;
+      std::vector<std::vector<char> >	m_scratch;
+      std::vector<size_t>		m_part_sizes;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERCOMPRESSION_H
@@ -0,0 +1,86 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERCORRECTION_H
+#define BASLERCORRECTION_H
+
+#include <vector>
+#include "BaslerCompatibility.h"
+
+namespace lima
+{
+  namespace Basler
+  {
+    /*******************************************************************
+     * \class Correction
+     * \brief dark, flat-field and defective pixel correction tables
+     *
+     * out = (raw - dark) * gain, with gain = mean(flat) / flat, rounded
+     * and clipped to the raw pixel range. Defective pixels are then
+     * replaced by the mean of their valid neighbours.
+     * correct() is reentrant, it's called in parallel on parts of a frame.
+     *******************************************************************/
+    class LIBBASLER_API Correction
+    {
+    public:
+      Correction();
+
+      void setSize(int width,int height);
+      int getWidth() const {return m_width;}
+      int getHeight() const {return m_height;}
+      int getNbPixels() const {return m_width * m_height;}
+
+      // tables of getNbPixels() values, an empty table clears the correction
+      void setDark(const std::vector<float>& dark);
+      void setFlat(const std::vector<float>& flat);
+      void setDefects(const std::vector<unsigned char>& defects);	// != 0 is defective
+      void clear();
+
+      bool hasDark() const {return m_has_dark;}
+      bool hasFlat() const {return m_has_flat;}
+      long getNbDefects() const {return long(m_defects.size());}
+
+      void swap(Correction& other);
+
+      // depth is the raw pixel size in bytes (1 or 2), max_value the
+      // largest raw pixel value (i.e 4095 for 12 bits), src may be dst
+      void correct(const void* src,void* dst,int depth,int max_value,
+		   int begin,int end) const;
+      void replaceDefects(void* dst,int depth) const;
+
+    private:
+      void _resetTables();
+
+      int			m_width;
+      int			m_height;
+      bool			m_has_dark;
+      bool			m_has_flat;
+      std::vector<float>	m_dark;
+      std::vector<float>	m_gain;
+      std::vector<int>		m_defects;
+      // neighbours of m_defects[i] are m_neighbours[m_first_neighbour[i]..[i+1][
+      std::vector<int>		m_first_neighbour;
+      std::vector<int>		m_neighbours;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERCORRECTION_H
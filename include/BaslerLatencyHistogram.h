@@ -0,0 +1,78 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERLATENCYHISTOGRAM_H
+#define BASLERLATENCYHISTOGRAM_H
+
+#include "BaslerCompatibility.h"
+
+namespace lima
+{
+  namespace Basler
+  {
+    /*******************************************************************
+     * \class LatencyHistogram
+     * \brief fixed buckets latency histogram
+     *
+     * Values are recorded in micro-seconds into log-linear buckets
+     * (HDR histogram like): each power of two is split into
+     * NB_SUB_BUCKETS linear buckets, giving a relative precision better
+     * than 1/NB_SUB_BUCKETS from 1 us up to 2^30 us (~18 minutes),
+     * longer latencies are counted in the last bucket.
+     * Recording is lock-free and allocation-free, it's meant to be called
+     * from the acquisition thread only.
+     *******************************************************************/
+    class LIBBASLER_API LatencyHistogram
+    {
+    public:
+      enum { NB_SUB_BUCKETS_BITS = 4,
+	     NB_SUB_BUCKETS = 1 << NB_SUB_BUCKETS_BITS,
+	     NB_MAGNITUDES = 28,
+	     NB_BUCKETS = NB_MAGNITUDES * NB_SUB_BUCKETS };
+
+      LatencyHistogram();
+
+      void reset();
+      void record(double latency);	// in seconds
+      void merge(const LatencyHistogram&);
+
+      long getCount() const {return m_count;}
+      double getMin() const;
+      double getMax() const;
+      double getMean() const;
+      double getPercentile(double percentile) const;
+
+      long getBucketCount(int bucket) const {return m_buckets[bucket];}
+      static double getBucketValue(int bucket);
+
+    private:
+      static int _getBucket(unsigned long long value);
+
+      long			m_buckets[NB_BUCKETS];
+      long			m_count;
+      unsigned long long	m_min;
+      unsigned long long	m_max;
+      double			m_sum;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERLATENCYHISTOGRAM_H
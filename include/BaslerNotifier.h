@@ -0,0 +1,88 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERNOTIFIER_H
+#define BASLERNOTIFIER_H
+
+#include <vector>
+#include "BaslerCompatibility.h"
+#include "BaslerAtomic.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+#include "lima/Exceptions.h"
+
+namespace lima
+{
+  namespace Basler
+  {
+    class LIBBASLER_API NotifyCallback
+    {
+    public:
+      virtual ~NotifyCallback() {}
+      // events pending since the previous call, or'ed
+      virtual void notify(int events) = 0;
+    };
+
+    /*******************************************************************
+     * \class Notifier
+     * \brief coalesced event notification to the plugin consumers
+     *
+     * post() or's the events into a pending mask per consumer and only
+     * wakes up a consumer when its mask was empty, so under load the
+     * producer doesn't pay more than an atomic operation per event.
+     * The consumers are an eventfd (Linux), readable while events are
+     * pending and cleared by readEvents(), and the callbacks, called
+     * from a dedicated thread started with the first registration.
+     * A wake-up may find no event (already consumed), it's harmless.
+     *******************************************************************/
+    class LIBBASLER_API Notifier
+    {
+      DEB_CLASS_NAMESPC(DebModCamera, "Notifier", "Basler");
+    public:
+      Notifier();
+      ~Notifier();
+
+      void post(int events);
+
+      int getFd() const {return m_fd;}	// -1 if not available
+      int readEvents();
+
+      void registerCallback(NotifyCallback& cb);
+      void unregisterCallback(NotifyCallback& cb);
+
+    private:
+      class _Thread;
+      friend class _Thread;
+
+      int				m_fd;
+      AtomicCounter			m_fd_pending;
+      AtomicCounter			m_cb_pending;
+      Cond				m_cond;
+      Mutex				m_callback_lock;
+      std::vector<NotifyCallback*>	m_callbacks;
+      volatile bool			m_has_callbacks;
+      bool				m_quit;
+      _Thread*				m_thread;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERNOTIFIER_H
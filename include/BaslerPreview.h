@@ -0,0 +1,91 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERPREVIEW_H
+#define BASLERPREVIEW_H
+
+#include <vector>
+#include "BaslerCompatibility.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+#include "lima/Exceptions.h"
+
+namespace lima
+{
+  namespace Basler
+  {
+    /*******************************************************************
+     * \class Preview
+     * \brief rate limited and subsampled copy of the acquired frames
+     *
+     * The acquisition thread checks isDue() for each frame and, at most
+     * once per interval, update() copies the frame keeping one pixel out
+     * of factor in each direction into a back buffer swapped with the
+     * front one under a short lock. The full rate buffers are only read.
+     *******************************************************************/
+    class LIBBASLER_API Preview
+    {
+      DEB_CLASS_NAMESPC(DebModCamera, "Preview", "Basler");
+    public:
+      struct Frame
+      {
+	int			width;
+	int			height;
+	int			depth;		// bytes per channel
+	int			channels;
+	long			frame_nb;
+	double			timestamp;
+	std::vector<char>	data;
+      };
+
+      Preview();
+
+      // in seconds, 0 disables the preview
+      void setInterval(double interval);
+      double getInterval() const {return m_interval;}
+      void setDownsampling(int factor);
+      int getDownsampling() const {return m_factor;}
+
+      // drops the last frame, the next one is due at once
+      void reset();
+      bool isDue(double time) const {return m_interval > 0. && time >= m_next_time;}
+      void update(const void* frame,int width,int height,int depth,int channels,
+		  long frame_nb,double time,double timestamp);
+
+      // false if no frame since the last reset
+      bool getLast(Frame& frame) const;
+
+    private:
+      template<class T> static void _subsample(const T* src,T* dst,int width,
+					       int height,int channels,int factor);
+
+      volatile double		m_interval;
+      volatile int		m_factor;
+      double			m_next_time;
+      Frame			m_back;
+      Frame			m_front;
+      bool			m_has_frame;
+      mutable Mutex		m_lock;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERPREVIEW_H
@@ -0,0 +1,153 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERRAWWRITER_H
+#define BASLERRAWWRITER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include "BaslerCompatibility.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+#include "lima/Exceptions.h"
+
+namespace lima
+{
+  namespace Basler
+  {
+    /*******************************************************************
+     * \class RawWriter
+     * \brief writes grabbed buffers straight to a raw file
+     *
+     * A writer thread takes the queued buffers in batches of up to
+     * MAX_BATCH frames and writes them with one vectored write, the file
+     * being opened with O_DIRECT when the filesystem allows it. Buffers
+     * must be ALIGNMENT aligned and hold a whole stride, they are given
+     * back with getWritten() once on disk.
+     *
+     * File layout: a FileHeader padded to ALIGNMENT bytes, the frames at
+     * data_offset + n * stride, then the FrameInfo table of the frames
+     * at index_offset, written by close(). The table is also appended to
+     * <filename>.idx after each batch, so it's kept if the process dies
+     * before close(), which copies it in the file and removes it.
+     *******************************************************************/
+    class LIBBASLER_API RawWriter
+    {
+      DEB_CLASS_NAMESPC(DebModCamera, "RawWriter", "Basler");
+    public:
+      enum {ALIGNMENT = 4096, MAX_BATCH = 16};
+
+      struct FileHeader
+      {
+	char			magic[8];	// "LIMARAW1"
+	unsigned int		width;
+	unsigned int		height;
+	unsigned int		depth;
+	unsigned int		reserved;
+	unsigned long long	frame_size;
+	unsigned long long	stride;
+	unsigned long long	data_offset;
+	unsigned long long	nb_frames;
+	unsigned long long	index_offset;
+      };
+
+      struct FrameInfo
+      {
+	long long		frame_nb;
+	double			timestamp;
+	unsigned long long	camera_timestamp;
+	unsigned int		status;
+	unsigned int		reserved;
+      };
+
+      struct Statistics
+      {
+	long	nb_frames;
+	double	nb_bytes;
+	double	throughput;		// MB/s since the first write
+	int	queue_depth;
+	int	max_queue_depth;
+      };
+
+      class Callback
+      {
+      public:
+	virtual ~Callback() {}
+	// called by the writer thread after each batch
+	virtual void framesWritten() = 0;
+      };
+
+      RawWriter();
+      ~RawWriter();
+
+      void setCallback(Callback* callback) {m_callback = callback;}
+
+      static size_t getStride(size_t frame_size);
+
+      void open(const std::string& filename,int width,int height,int depth,
+		size_t frame_size);
+      bool isOpen() const {return m_fd >= 0;}
+      void write(const void* buffer,void* context,const FrameInfo& info);
+      // contexts of the buffers written since the last call
+      void getWritten(std::vector<void*>& contexts);
+      bool getError(std::string& error);
+      // writes the pending frames and the frame table
+      void close();
+
+      void getStatistics(Statistics& stats);
+
+    private:
+      class _WriterThread;
+      friend class _WriterThread;
+
+      struct _Frame
+      {
+	const void*	buffer;
+	void*		context;
+	FrameInfo	info;
+      };
+
+      void _run();
+      bool _writeBatch(int nb_frames,unsigned long long offset);
+      bool _appendIndex(const FrameInfo* infos,int nb_frames,unsigned long long first_frame);
+      void _writeIndex();
+
+      Cond			m_cond;
+      Callback*			m_callback;
+      _WriterThread*		m_thread;
+      int			m_fd;
+      int			m_index_fd;
+      std::string		m_filename;
+      FileHeader		m_header;
+      std::deque<_Frame>	m_queue;
+      std::vector<void*>	m_written;
+      unsigned long long	m_nb_written;
+      double			m_start_time;
+      double			m_last_time;
+      int			m_max_queue_depth;
+      std::string		m_error;
+      bool			m_closing;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERRAWWRITER_H
@@ -0,0 +1,131 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERSHMRING_H
+#define BASLERSHMRING_H
+
+#include <string>
+#include "BaslerCompatibility.h"
+#include "BaslerAtomic.h"
+#include "lima/Debug.h"
+#include "lima/Exceptions.h"
+
+namespace lima
+{
+  namespace Basler
+  {
+    /*******************************************************************
+     * \class ShmRing
+     * \brief ring of frames in POSIX shared memory
+     *
+     * One writer (the plugin) publishes the frames, any number of reader
+     * processes map the segment read-only and use the frames in place.
+     * The writer never waits for the readers: each slot has a sequence
+     * number, odd while written and 2 * n + 2 once frame n is complete,
+     * a reader checks it before and after using the frame to detect an
+     * overrun.
+     *
+     * Segment layout: the Header at 0, the Slot table at slots_offset
+     * (nb_slots entries) and the frames at data_offset + slot * slot_size.
+     * write_count is the number of frames published so far.
+     *******************************************************************/
+    class LIBBASLER_API ShmRing
+    {
+      DEB_CLASS_NAMESPC(DebModCamera, "ShmRing", "Basler");
+    public:
+      enum {ALIGNMENT = 4096};
+
+      struct Header
+      {
+	char			magic[8];	// "LIMASHM1"
+	unsigned int		width;
+	unsigned int		height;
+	unsigned int		depth;
+	unsigned int		nb_slots;
+	unsigned long long	frame_size;
+	unsigned long long	slot_size;
+	unsigned long long	slots_offset;
+	unsigned long long	data_offset;
+	AtomicCounter		closed;		// set before the segment is removed
+	AtomicCounter		write_count;	// at 64, own cache line
+      };
+
+      struct Slot
+      {
+	AtomicCounter		sequence;
+	long long		frame_nb;
+	double			timestamp;
+	unsigned long long	camera_timestamp;
+	char			padding[32];
+      };
+
+      class LIBBASLER_API Reader
+      {
+	DEB_CLASS_NAMESPC(DebModCamera, "ShmRing::Reader", "Basler");
+      public:
+	enum Status {Ok, NotReady, Overrun, Closed};
+
+	Reader();
+	~Reader();
+
+	// starts with the next published frame
+	void open(const std::string& name);
+	void close();
+	bool isOpen() const {return m_header != NULL;}
+	const Header& getHeader() const {return *m_header;}
+
+	// data points to the frame in the segment, valid until overwritten
+	Status next(const void*& data,Slot& info);
+	// true if the last frame given by next() wasn't overwritten meanwhile
+	bool validate() const;
+	unsigned long long getNbOverruns() const {return m_nb_overruns;}
+
+      private:
+	Header*			m_header;
+	size_t			m_size;
+	unsigned long long	m_next;
+	const Slot*		m_slot;
+	unsigned long long	m_sequence;
+	unsigned long long	m_nb_overruns;
+      };
+
+      ShmRing();
+      ~ShmRing();
+
+      void create(const std::string& name,int width,int height,int depth,int nb_slots);
+      bool isOpen() const {return m_header != NULL;}
+      const std::string& getName() const {return m_name;}
+      // marks the segment closed for the readers and removes it
+      void close();
+
+      void publish(const void* frame,long long frame_nb,double timestamp,
+		   unsigned long long camera_timestamp);
+      unsigned long long getNbPublished() const;
+
+    private:
+      std::string		m_name;
+      Header*			m_header;
+      size_t			m_size;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERSHMRING_H
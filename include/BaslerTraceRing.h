@@ -0,0 +1,108 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERTRACERING_H
+#define BASLERTRACERING_H
+
+#include <vector>
+#include "BaslerCompatibility.h"
+#include "BaslerAtomic.h"
+#include "lima/Debug.h"
+#include "lima/Exceptions.h"
+
+// Trace points of the acquisition hot path, compiled out with
+// BASLER_NO_TRACE. The arguments are not evaluated in that case.
+#ifdef BASLER_NO_TRACE
+#define BASLER_TRACE(ring,type,frame_nb,arg,timestamp)
+#else
+#define BASLER_TRACE(ring,type,frame_nb,arg,timestamp)	\
+  (ring).record(type,frame_nb,arg,timestamp)
+#endif
+
+namespace lima
+{
+  namespace Basler
+  {
+    /*******************************************************************
+     * \class TraceRing
+     * \brief lock-free ring of timestamped binary events
+     *
+     * Any thread can record, a slot is reserved with an atomic increment
+     * of the write index (the only locked instruction) and carries a
+     * sequence number (odd while written, 2 * index + 2 once complete,
+     * plain stores on x86) so read() skips the slots being overwritten. Nothing is formatted nor allocated when recording,
+     * the oldest events are overwritten when the ring is full.
+     * The size can't be changed while events are recorded.
+     *******************************************************************/
+    class LIBBASLER_API TraceRing
+    {
+      DEB_CLASS_NAMESPC(DebModCamera, "TraceRing", "Basler");
+    public:
+      struct Event
+      {
+	double		timestamp;
+	long long	frame_nb;
+	int		type;
+	int		arg;
+      };
+
+      TraceRing();
+      ~TraceRing();
+
+      // rounded up to a power of two, 0 disables the ring
+      void setSize(int nb_events);
+      int getSize() const {return m_slots ? int(m_mask + 1) : 0;}
+      void reset();
+
+      void record(int type,long long frame_nb,int arg,double timestamp)
+      {
+	if(!m_slots)
+	  return;
+	unsigned long long index = atomicAdd(&m_write_index,1) - 1;
+	Slot& slot = m_slots[index & m_mask];
+	atomicStore(&slot.sequence,2 * index + 1);
+	atomicWriteFence();
+	slot.event.timestamp = timestamp;
+	slot.event.frame_nb = frame_nb;
+	slot.event.type = type;
+	slot.event.arg = arg;
+	atomicStore(&slot.sequence,2 * index + 2);
+      }
+
+      // events still in the ring, oldest first
+      void read(std::vector<Event>& events) const;
+      unsigned long long getNbRecorded() const {return atomicLoad(&m_write_index);}
+
+    private:
+      struct Slot
+      {
+	AtomicCounter	sequence;
+	Event		event;
+      };
+
+      Slot*			m_slots;
+      unsigned long long	m_mask;
+      AtomicCounter		m_write_index;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERTRACERING_H
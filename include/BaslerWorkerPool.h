@@ -0,0 +1,80 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#ifndef BASLERWORKERPOOL_H
+#define BASLERWORKERPOOL_H
+
+#include <vector>
+#include "BaslerCompatibility.h"
+#include "lima/ThreadUtils.h"
+#include "lima/Debug.h"
+#include "lima/Exceptions.h"
+
+namespace lima
+{
+  namespace Basler
+  {
+    /*******************************************************************
+     * \class WorkerPool
+     * \brief split a frame processing over several threads
+     *
+     * run() calls Task::process(part,nb_parts) once for each part, the
+     * calling thread takes part 0 and the workers the others, and returns
+     * when all the parts are done. Threads are started on the first run.
+     *******************************************************************/
+    class LIBBASLER_API WorkerPool
+    {
+      DEB_CLASS_NAMESPC(DebModCamera, "WorkerPool", "Basler");
+    public:
+      class Task
+      {
+      public:
+	virtual ~Task() {}
+	virtual void process(int part,int nb_parts) = 0;
+      };
+
+      WorkerPool();
+      ~WorkerPool();
+
+      void setNbThreads(int nb_threads);
+      int getNbThreads() const {return m_nb_threads;}
+
+      void run(Task& task);
+
+    private:
+      class _Worker;
+      friend class _Worker;
+
+      void _startWorkers();
+      void _stopWorkers();
+
+      Cond			m_cond;
+      int			m_nb_threads;
+      std::vector<_Worker*>	m_workers;
+      Task*			m_task;
+      int			m_generation;
+      int			m_pending;
+      bool			m_quit;
+    };
+  } // namespace Basler
+} // namespace lima
+
+#endif // BASLERWORKERPOOL_H
@@ -1,5 +1,61 @@
+import numpy
 from Lima import Core
 from limabasler import Basler as _B
 globals().update(_B.__dict__)
 
+class _FrameView(object):
+    """Pins a frame buffer of the camera while a numpy view uses it"""
 
+    def __init__(self, cam, frame_nb):
+        address, width, height, depth, channels, self.frame_nb = cam.pinFrame(frame_nb)
+        self._cam = cam
+        self._address = address
+        if channels == 0:
+            shape = (width,)
+        elif channels == 1:
+            shape = (height, width)
+        else:
+            shape = (height, width, channels)
+        typestr = '|u1' if depth == 1 else '<u%d' % depth
+        self.__array_interface__ = {'version': 3,
+                                    'shape': shape,
+                                    'typestr': typestr,
+                                    'data': (address, True)}
+
+    def __del__(self):
+        self._cam.unpinFrame(self._address)
+
+def getFrameView(cam, frame_nb=-1):
+    """Read-only numpy array of a frame, without copy.
+
+    cam is the Basler.Camera, frame_nb -1 is the last frame. The buffer
+    is not written while the view is alive. Only a frame whose buffer
+    is out of the grab queue can be viewed (see cam.isFrameValid): in
+    video mode the last frame, otherwise any frame still in the ring once
+    the acquisition is stopped, or the last frames of a fixed length
+    acquisition. Returns (array, frame_nb).
+    """
+    view = _FrameView(cam, frame_nb)
+    return numpy.asarray(view), view.frame_nb
+
+
+
+def _getLoop(loop):
+    if loop is None:
+        import asyncio
+        loop = asyncio.get_event_loop()
+    return loop
+
+def waitFrameAsync(cam, frame_nb, timeout=-1., loop=None, executor=None):
+    """asyncio future of cam.waitFrame(frame_nb, timeout).
+
+    The wait releases the GIL and runs in the executor (the loop default
+    executor if None), the result is (acquired, last_frame).
+    """
+    return _getLoop(loop).run_in_executor(executor, cam.waitFrame,
+                                          frame_nb, timeout)
+
+def waitAcqEndAsync(cam, timeout=-1., loop=None, executor=None):
+    """asyncio future of cam.waitAcqEnd(timeout), True once the
+    acquisition is finished."""
+    return _getLoop(loop).run_in_executor(executor, cam.waitAcqEnd, timeout)
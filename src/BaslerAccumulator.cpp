@@ -0,0 +1,207 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "BaslerAccumulator.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BASLER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Basler;
+
+// dst = src (first frame of a group) or dst += src, widened to 32 bits
+static void _add_frame(const unsigned short* src,unsigned int* dst,int n,bool first)
+{
+  int i = 0;
+#ifdef BASLER_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for(;i + 8 <= n;i += 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i lo = _mm_unpacklo_epi16(v,zero);
+      __m128i hi = _mm_unpackhi_epi16(v,zero);
+      if(!first)
+	{
+	  lo = _mm_add_epi32(lo,_mm_loadu_si128((const __m128i*)(dst + i)));
+	  hi = _mm_add_epi32(hi,_mm_loadu_si128((const __m128i*)(dst + i + 4)));
+	}
+      _mm_storeu_si128((__m128i*)(dst + i),lo);
+      _mm_storeu_si128((__m128i*)(dst + i + 4),hi);
+    }
+#endif
+  if(first)
+    for(;i < n;++i) dst[i] = src[i];
+  else
+    for(;i < n;++i) dst[i] += src[i];
+}
+
+static void _add_frame(const unsigned char* src,unsigned int* dst,int n,bool first)
+{
+  int i = 0;
+#ifdef BASLER_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for(;i + 16 <= n;i += 16)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i v16[2] = {_mm_unpacklo_epi8(v,zero),_mm_unpackhi_epi8(v,zero)};
+      for(int j = 0;j < 2;++j)
+	{
+	  __m128i lo = _mm_unpacklo_epi16(v16[j],zero);
+	  __m128i hi = _mm_unpackhi_epi16(v16[j],zero);
+	  unsigned int* d = dst + i + j * 8;
+	  if(!first)
+	    {
+	      lo = _mm_add_epi32(lo,_mm_loadu_si128((const __m128i*)d));
+	      hi = _mm_add_epi32(hi,_mm_loadu_si128((const __m128i*)(d + 4)));
+	    }
+	  _mm_storeu_si128((__m128i*)d,lo);
+	  _mm_storeu_si128((__m128i*)(d + 4),hi);
+	}
+    }
+#endif
+  if(first)
+    for(;i < n;++i) dst[i] = src[i];
+  else
+    for(;i < n;++i) dst[i] += src[i];
+}
+
+Accumulator::Accumulator() :
+  m_nb_frames(1),
+  m_mode(Sum),
+  m_run_statistics(false),
+  m_nb_pixels(0),
+  m_depth(2),
+  m_frame_in_group(0),
+  m_nb_run_frames(0)
+{
+}
+
+void Accumulator::setNbFrames(int nb_frames)
+{
+  m_nb_frames = nb_frames > 1 ? nb_frames : 1;
+}
+
+void Accumulator::prepare(int nb_pixels,int depth)
+{
+  m_nb_pixels = nb_pixels;
+  m_depth = depth;
+  m_frame_in_group = 0;
+  m_nb_run_frames = 0;
+  if(m_run_statistics)
+    {
+      m_run_sum.assign(nb_pixels,0);
+      m_run_sum2.assign(nb_pixels,0);
+      m_run_min.assign(nb_pixels,0xffff);
+      m_run_max.assign(nb_pixels,0);
+    }
+  else
+    {
+      m_run_sum.clear();
+      m_run_sum2.clear();
+      m_run_min.clear();
+      m_run_max.clear();
+    }
+}
+
+template<class T>
+void Accumulator::_updateRun(const T* raw)
+{
+  unsigned long long* sum = &m_run_sum[0];
+  unsigned long long* sum2 = &m_run_sum2[0];
+  unsigned short* min = &m_run_min[0];
+  unsigned short* max = &m_run_max[0];
+  for(int i = 0;i < m_nb_pixels;++i)
+    {
+      unsigned int v = raw[i];
+      sum[i] += v;
+      sum2[i] += v * v;
+      if(v < min[i]) min[i] = v;
+      if(v > max[i]) max[i] = v;
+    }
+}
+
+bool Accumulator::add(const void* raw,unsigned int* dst)
+{
+  bool first = !m_frame_in_group;
+  if(m_depth == 1)
+    _add_frame((const unsigned char*)raw,dst,m_nb_pixels,first);
+  else
+    _add_frame((const unsigned short*)raw,dst,m_nb_pixels,first);
+
+  addToRun(raw);
+
+  if(++m_frame_in_group < m_nb_frames)
+    return false;
+
+  m_frame_in_group = 0;
+  if(m_mode == Average && m_nb_frames > 1)
+    {
+      unsigned int half = m_nb_frames / 2;
+      for(int i = 0;i < m_nb_pixels;++i)
+	dst[i] = (dst[i] + half) / m_nb_frames;
+    }
+  return true;
+}
+
+void Accumulator::addToRun(const void* raw)
+{
+  if(!m_run_statistics || m_run_sum.empty())
+    return;
+
+  if(m_depth == 1)
+    _updateRun((const unsigned char*)raw);
+  else
+    _updateRun((const unsigned short*)raw);
+  ++m_nb_run_frames;
+}
+
+void Accumulator::getRunMap(RunMap map,double* values) const
+{
+  if(m_run_sum.empty() || !m_nb_run_frames)
+    {
+      for(int i = 0;i < m_nb_pixels;++i) values[i] = 0.;
+      return;
+    }
+
+  double nb_frames = double(m_nb_run_frames);
+  for(int i = 0;i < m_nb_pixels;++i)
+    switch(map)
+      {
+      case Mean:
+	values[i] = m_run_sum[i] / nb_frames;
+	break;
+      case Variance:
+	{
+	  double mean = m_run_sum[i] / nb_frames;
+	  double variance = m_run_sum2[i] / nb_frames - mean * mean;
+	  values[i] = variance > 0. ? variance : 0.;
+	}
+	break;
+      case Min:
+	values[i] = m_run_min[i];
+	break;
+      case Max:
+	values[i] = m_run_max[i];
+	break;
+      }
+}
@@ -0,0 +1,248 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#include "BaslerBeamMonitor.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BASLER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Basler;
+
+const static int DEFAULT_HISTORY_SIZE = 10000;
+
+// profile[x] += src[x], returns the sum of the row and updates max
+static unsigned int _add_row(const unsigned short* src,unsigned int* profile,int n,
+			     unsigned int& max)
+{
+  int i = 0;
+  unsigned int sum = 0;
+  unsigned int row_max = max;
+#ifdef BASLER_SSE2
+  if(n >= 8)
+    {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i sign = _mm_set1_epi16(short(0x8000));
+      __m128i vsum = _mm_setzero_si128();
+      // no unsigned 16 bits max in SSE2, compare biased values
+      __m128i vmax = sign;
+      for(;i + 8 <= n;i += 8)
+	{
+	  __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+	  vmax = _mm_max_epi16(vmax,_mm_xor_si128(v,sign));
+	  __m128i lo = _mm_unpacklo_epi16(v,zero);
+	  __m128i hi = _mm_unpackhi_epi16(v,zero);
+	  vsum = _mm_add_epi32(vsum,_mm_add_epi32(lo,hi));
+	  _mm_storeu_si128((__m128i*)(profile + i),
+			   _mm_add_epi32(lo,_mm_loadu_si128((const __m128i*)(profile + i))));
+	  _mm_storeu_si128((__m128i*)(profile + i + 4),
+			   _mm_add_epi32(hi,_mm_loadu_si128((const __m128i*)(profile + i + 4))));
+	}
+      unsigned int sums[4];
+      unsigned short maxs[8];
+      _mm_storeu_si128((__m128i*)sums,vsum);
+      _mm_storeu_si128((__m128i*)maxs,_mm_xor_si128(vmax,sign));
+      sum = sums[0] + sums[1] + sums[2] + sums[3];
+      for(int j = 0;j < 8;++j)
+	if(maxs[j] > row_max) row_max = maxs[j];
+    }
+#endif
+  for(;i < n;++i)
+    {
+      profile[i] += src[i];
+      sum += src[i];
+      if(src[i] > row_max) row_max = src[i];
+    }
+  max = row_max;
+  return sum;
+}
+
+static unsigned int _add_row(const unsigned char* src,unsigned int* profile,int n,
+			     unsigned int& max)
+{
+  int i = 0;
+  unsigned int sum = 0;
+  unsigned int row_max = max;
+#ifdef BASLER_SSE2
+  if(n >= 16)
+    {
+      const __m128i zero = _mm_setzero_si128();
+      __m128i vsum = _mm_setzero_si128();
+      __m128i vmax = _mm_setzero_si128();
+      for(;i + 16 <= n;i += 16)
+	{
+	  __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+	  vmax = _mm_max_epu8(vmax,v);
+	  // sum of absolute differences to zero gives two 64 bits partial sums
+	  vsum = _mm_add_epi32(vsum,_mm_sad_epu8(v,zero));
+	  __m128i v16[2] = {_mm_unpacklo_epi8(v,zero),_mm_unpackhi_epi8(v,zero)};
+	  for(int j = 0;j < 2;++j)
+	    {
+	      unsigned int* p = profile + i + j * 8;
+	      _mm_storeu_si128((__m128i*)p,
+			       _mm_add_epi32(_mm_unpacklo_epi16(v16[j],zero),
+					     _mm_loadu_si128((const __m128i*)p)));
+	      _mm_storeu_si128((__m128i*)(p + 4),
+			       _mm_add_epi32(_mm_unpackhi_epi16(v16[j],zero),
+					     _mm_loadu_si128((const __m128i*)(p + 4))));
+	    }
+	}
+      unsigned int sums[4];
+      unsigned char maxs[16];
+      _mm_storeu_si128((__m128i*)sums,vsum);
+      _mm_storeu_si128((__m128i*)maxs,vmax);
+      sum = sums[0] + sums[2];
+      for(int j = 0;j < 16;++j)
+	if(maxs[j] > row_max) row_max = maxs[j];
+    }
+#endif
+  for(;i < n;++i)
+    {
+      profile[i] += src[i];
+      sum += src[i];
+      if(src[i] > row_max) row_max = src[i];
+    }
+  max = row_max;
+  return sum;
+}
+
+BeamMonitor::BeamMonitor() :
+  m_history_size(DEFAULT_HISTORY_SIZE),
+  m_width(0),
+  m_height(0),
+  m_depth(2),
+  m_nb_frames(0)
+{
+}
+
+void BeamMonitor::setRois(const std::vector<Roi>& rois)
+{
+  m_rois = rois;
+  m_history.clear();
+  m_nb_frames = 0;
+}
+
+void BeamMonitor::setHistorySize(int nb_frames)
+{
+  m_history_size = nb_frames < 1 ? 1 : nb_frames;
+  m_history.clear();
+  m_nb_frames = 0;
+}
+
+void BeamMonitor::prepare(int width,int height,int depth)
+{
+  m_width = width;
+  m_height = height;
+  m_depth = depth;
+  m_nb_frames = 0;
+  m_history.assign(size_t(m_history_size) * m_rois.size(),Stats());
+}
+
+void BeamMonitor::process(const void* frame,double timestamp)
+{
+  if(m_rois.empty() || m_history.empty())
+    return;
+
+  size_t nb_rois = m_rois.size();
+  Stats* stats = &m_history[size_t(m_nb_frames % m_history_size) * nb_rois];
+  for(size_t r = 0;r < nb_rois;++r)
+    {
+      stats[r].frame_nb = m_nb_frames;
+      stats[r].timestamp = timestamp;
+      stats[r].roi_index = int(r);
+      if(m_depth == 1)
+	_process((const unsigned char*)frame,m_rois[r],stats[r]);
+      else
+	_process((const unsigned short*)frame,m_rois[r],stats[r]);
+    }
+  ++m_nb_frames;
+}
+
+template<class T>
+void BeamMonitor::_process(const T* frame,const Roi& roi,Stats& stats)
+{
+  m_profile_x.assign(roi.width,0);
+  m_profile_y.resize(roi.height);
+  unsigned int max = 0;
+  for(int y = 0;y < roi.height;++y)
+    {
+      const T* row = frame + size_t(roi.y + y) * m_width + roi.x;
+      m_profile_y[y] = _add_row(row,&m_profile_x[0],roi.width,max);
+    }
+
+  double sum = 0.,moment_x = 0.,moment_y = 0.;
+  for(int y = 0;y < roi.height;++y)
+    {
+      sum += m_profile_y[y];
+      moment_y += y * m_profile_y[y];
+    }
+  m_profile.resize(roi.width);
+  for(int x = 0;x < roi.width;++x)
+    {
+      m_profile[x] = m_profile_x[x];
+      moment_x += x * m_profile[x];
+    }
+
+  stats.sum = sum;
+  stats.max = max;
+  stats.centroid_x = sum > 0. ? roi.x + moment_x / sum : 0.;
+  stats.centroid_y = sum > 0. ? roi.y + moment_y / sum : 0.;
+  stats.fwhm_x = _fwhm(m_profile);
+  stats.fwhm_y = _fwhm(m_profile_y);
+}
+
+// Width at half height above the profile minimum, linearly interpolated
+double BeamMonitor::_fwhm(const std::vector<double>& profile)
+{
+  int n = int(profile.size());
+  if(n < 2) return 0.;
+  int peak = int(std::max_element(profile.begin(),profile.end()) - profile.begin());
+  double low = *std::min_element(profile.begin(),profile.end());
+  if(profile[peak] <= low) return 0.;
+  double half = low + (profile[peak] - low) / 2.;
+
+  int i = peak;
+  while(i > 0 && profile[i - 1] >= half) --i;
+  double left = i > 0 ?
+    i - (profile[i] - half) / (profile[i] - profile[i - 1]) : 0.;
+  int j = peak;
+  while(j < n - 1 && profile[j + 1] >= half) ++j;
+  double right = j < n - 1 ?
+    j + (profile[j] - half) / (profile[j] - profile[j + 1]) : double(n - 1);
+  return right - left;
+}
+
+void BeamMonitor::read(long from_frame,std::vector<Stats>& stats) const
+{
+  stats.clear();
+  if(m_history.empty())
+    return;
+  long first = std::max(from_frame,std::max(m_nb_frames - m_history_size,0L));
+  size_t nb_rois = m_rois.size();
+  for(long frame_nb = first;frame_nb < m_nb_frames;++frame_nb)
+    {
+      const Stats* s = &m_history[size_t(frame_nb % m_history_size) * nb_rois];
+      stats.insert(stats.end(),s,s + nb_rois);
+    }
+}
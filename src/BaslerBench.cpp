@@ -0,0 +1,516 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+//
+// Standalone acquisition benchmark: opens a camera without the Lima
+// control layer, runs nb_acq acquisitions of nb_frames frames for each
+// trigger mode and prints fps, dead time, losses and latency percentiles
+// as JSON.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <string>
+#include <vector>
+#include "BaslerCamera.h"
+#include "BaslerAtomic.h"
+
+using namespace lima;
+using namespace lima::Basler;
+
+// camera id of the first device of the Pylon camera emulator
+static const char* SIMULATED_CAMERA_ID = "0815-0000";
+
+struct BenchOptions
+{
+  std::string		camera_id;
+  bool			simulate;
+  int			roi[4];
+  int			bin[2];
+  std::string		pixel_format;
+  int			packet_size;
+  double		exp_time;
+  double		lat_time;
+  int			nb_frames;
+  int			nb_acq;
+  int			nb_buffers;
+  double		timeout;
+  std::vector<std::string>	trig_modes;
+  std::string		output;
+};
+
+struct AcqResult
+{
+  long		nb_frames;
+  long		delivered_frames;	// to the frame callback
+  long		lost_frames;
+  double	fps;
+  double	rearm_time;
+  double	dead_time;	// from the last frame of the previous acquisition
+  long		failed_buffers;
+  long		lost_packets;
+  long		resend_requests;
+  bool		fault;
+};
+
+struct ModeResult
+{
+  std::string		trig_mode;
+  std::string		error;
+  std::vector<AcqResult>	acqs;
+  LatencyHistogram	latency[Camera::NB_LATENCY_STAGE];
+};
+
+static const char* StageNames[] = {"transfer","requeue","delivery","total"};
+
+static void usage(const char* prog)
+{
+  fprintf(stderr,
+	  "usage: %s (--camera <ip|serial|name> | --simulate) [options]\n"
+	  "  --roi x,y,width,height    hardware roi\n"
+	  "  --bin x,y                 binning\n"
+	  "  --pixel-format Bpp8|Bpp12|Bpp16\n"
+	  "  --packet-size bytes       GigE packet size\n"
+	  "  --exposure s              exposure time\n"
+	  "  --latency s               latency time between frames\n"
+	  "  --frames M                frames per acquisition (default 100)\n"
+	  "  --acquisitions N          acquisitions per trigger mode (default 10)\n"
+	  "  --trig-modes list         IntTrig,ExtTrigSingle,ExtGate (default IntTrig)\n"
+	  "  --buffers nb              Lima buffers (default 64)\n"
+	  "  --timeout s               frame timeout (default 10)\n"
+	  "  --output file             JSON report (default stdout)\n",
+	  prog);
+}
+
+static bool parse_ints(const char* arg,int* values,int nb_values)
+{
+  char* end;
+  for(int i = 0;i < nb_values;++i)
+    {
+      values[i] = strtol(arg,&end,10);
+      if(end == arg || (i < nb_values - 1 ? *end != ',' : *end != '\0'))
+	return false;
+      arg = end + 1;
+    }
+  return true;
+}
+
+static void split(const std::string& list,std::vector<std::string>& items)
+{
+  std::string::size_type start = 0;
+  while(start <= list.size())
+    {
+      std::string::size_type end = list.find(',',start);
+      if(end == std::string::npos)
+	end = list.size();
+      if(end > start)
+	items.push_back(list.substr(start,end - start));
+      start = end + 1;
+    }
+}
+
+static bool parse_options(int argc,char* argv[],BenchOptions& opt)
+{
+  static struct option long_options[] = {
+    {"camera",		required_argument,	0,	'c'},
+    {"simulate",	no_argument,		0,	's'},
+    {"roi",		required_argument,	0,	'r'},
+    {"bin",		required_argument,	0,	'b'},
+    {"pixel-format",	required_argument,	0,	'p'},
+    {"packet-size",	required_argument,	0,	'P'},
+    {"exposure",	required_argument,	0,	'e'},
+    {"latency",		required_argument,	0,	'l'},
+    {"frames",		required_argument,	0,	'f'},
+    {"acquisitions",	required_argument,	0,	'n'},
+    {"trig-modes",	required_argument,	0,	't'},
+    {"buffers",		required_argument,	0,	'B'},
+    {"timeout",		required_argument,	0,	'T'},
+    {"output",		required_argument,	0,	'o'},
+    {"help",		no_argument,		0,	'h'},
+    {0,0,0,0}
+  };
+
+  opt.simulate = false;
+  memset(opt.roi,0,sizeof(opt.roi));
+  opt.bin[0] = opt.bin[1] = 1;
+  opt.packet_size = -1;
+  opt.exp_time = -1.;
+  opt.lat_time = -1.;
+  opt.nb_frames = 100;
+  opt.nb_acq = 10;
+  opt.nb_buffers = 64;
+  opt.timeout = 10.;
+
+  int c;
+  while((c = getopt_long(argc,argv,"c:sr:b:p:P:e:l:f:n:t:B:T:o:h",
+			 long_options,NULL)) != -1)
+    {
+      switch(c)
+	{
+	case 'c': opt.camera_id = optarg;break;
+	case 's': opt.simulate = true;break;
+	case 'r':
+	  if(!parse_ints(optarg,opt.roi,4)) return false;
+	  break;
+	case 'b':
+	  if(!parse_ints(optarg,opt.bin,2)) return false;
+	  break;
+	case 'p': opt.pixel_format = optarg;break;
+	case 'P': opt.packet_size = atoi(optarg);break;
+	case 'e': opt.exp_time = atof(optarg);break;
+	case 'l': opt.lat_time = atof(optarg);break;
+	case 'f': opt.nb_frames = atoi(optarg);break;
+	case 'n': opt.nb_acq = atoi(optarg);break;
+	case 't': split(optarg,opt.trig_modes);break;
+	case 'B': opt.nb_buffers = atoi(optarg);break;
+	case 'T': opt.timeout = atof(optarg);break;
+	case 'o': opt.output = optarg;break;
+	default: return false;
+	}
+    }
+  if(opt.simulate)
+    {
+      // enable the Pylon camera emulator
+      setenv("PYLON_CAMEMU","1",0);
+      if(opt.camera_id.empty())
+	opt.camera_id = SIMULATED_CAMERA_ID;
+    }
+  if(opt.trig_modes.empty())
+    opt.trig_modes.push_back("IntTrig");
+  return (optind == argc && !opt.camera_id.empty() &&
+	  opt.nb_frames > 0 && opt.nb_acq > 0 && opt.nb_buffers > 0);
+}
+
+static bool get_trig_mode(const std::string& name,TrigMode& mode)
+{
+  if(name == "IntTrig") mode = IntTrig;
+  else if(name == "ExtTrigSingle") mode = ExtTrigSingle;
+  else if(name == "ExtGate") mode = ExtGate;
+  else return false;
+  return true;
+}
+
+static void configure(Camera& cam,const BenchOptions& opt)
+{
+  Bin bin(opt.bin[0],opt.bin[1]);
+  if(!bin.isOne())
+    cam.setBin(bin);
+  Roi roi(opt.roi[0],opt.roi[1],opt.roi[2],opt.roi[3]);
+  if(!roi.isEmpty())
+    cam.setRoi(roi);
+  if(!opt.pixel_format.empty())
+    {
+      ImageType type;
+      if(opt.pixel_format == "Bpp8") type = Bpp8;
+      else if(opt.pixel_format == "Bpp12") type = Bpp12;
+      else if(opt.pixel_format == "Bpp16") type = Bpp16;
+      else
+	throw LIMA_HW_EXC(InvalidValue,"Invalid pixel format: " + opt.pixel_format);
+      cam.setImageType(type);
+    }
+  if(opt.exp_time >= 0.)
+    cam.setExpTime(opt.exp_time);
+  if(opt.lat_time >= 0.)
+    cam.setLatTime(opt.lat_time);
+  cam.setNbFrames(opt.nb_frames);
+}
+
+// Stands for the Lima control layer, the acquisition goes on as long
+// as newFrameReady returns true. Called by the acquisition thread.
+class BenchFrameCallback : public HwFrameCallback
+{
+public:
+  BenchFrameCallback() : m_nb_frames(0) {}
+  void reset() {atomicStore(&m_nb_frames,0);}
+  long getNbFrames() const {return long(atomicLoad(&m_nb_frames));}
+protected:
+  virtual bool newFrameReady(const HwFrameInfoType&)
+  {
+    atomicAdd(&m_nb_frames,1);
+    return true;
+  }
+private:
+  AtomicCounter	m_nb_frames;
+};
+
+// the Lima buffers are allocated here as CtControl would do
+static void alloc_buffers(Camera& cam,const BenchOptions& opt,BenchFrameCallback& frame_cb)
+{
+  Roi roi;
+  cam.getRoi(roi);
+  Size size = roi.getSize();
+  if(!size.getWidth() || !size.getHeight())
+    {
+      Bin bin;
+      cam.getBin(bin);
+      cam.getDetectorImageSize(size);
+      size = Size(size.getWidth() / bin.getX(),size.getHeight() / bin.getY());
+    }
+  ImageType type;
+  cam.getImageType(type);
+  HwBufferCtrlObj* buffer = cam.getBufferCtrlObj();
+  buffer->setFrameDim(FrameDim(size,type));
+  buffer->setNbBuffers(opt.nb_buffers);
+  buffer->registerFrameCallback(frame_cb);
+}
+
+static void run_acquisition(Camera& cam,const BenchOptions& opt,
+			    BenchFrameCallback& frame_cb,double& last_frame_time,
+			    AcqResult& res,LatencyHistogram* latency)
+{
+  frame_cb.reset();
+  Timestamp start = Timestamp::now();
+  cam.prepareAcq();
+  cam.startAcq();
+  res.rearm_time = Timestamp::now() - start;
+
+  double first_time = -1.,last_time = -1.;
+  long next_frame = 0,last_frame;
+  while(next_frame < opt.nb_frames)
+    {
+      if(!cam.waitFrame(next_frame,opt.timeout,last_frame))
+	break;
+      double now = Timestamp::now();
+      if(first_time < 0.)
+	first_time = now;
+      last_time = now;
+      next_frame = last_frame + 1;
+    }
+  if(!cam.waitAcqEnd(opt.timeout))
+    cam.stopAcq();
+
+  // a frame is only lost for Lima if it never reached the callback
+  res.nb_frames = next_frame;
+  res.delivered_frames = frame_cb.getNbFrames();
+  res.lost_frames = opt.nb_frames - res.delivered_frames;
+  res.fps = (next_frame > 1 && last_time > first_time) ?
+    (next_frame - 1) / (last_time - first_time) : 0.;
+  res.dead_time = (last_frame_time >= 0. && first_time >= 0.) ?
+    first_time - last_frame_time : -1.;
+  if(last_time >= 0.)
+    last_frame_time = last_time;
+
+  Camera::StreamStatistics stats;
+  cam.getStreamStatistics(stats);
+  res.failed_buffers = stats.failed_buffer_count;
+  res.lost_packets = stats.lost_packet_count;
+  res.resend_requests = stats.resend_request_count;
+  Camera::Status status;
+  cam.getStatus(status);
+  res.fault = status == Camera::Fault;
+
+  for(int i = 0;i < Camera::NB_LATENCY_STAGE;++i)
+    latency[i].merge(cam.getLatencyHistogram(Camera::LatencyStage(i)));
+}
+
+static void run_mode(Camera& cam,const BenchOptions& opt,BenchFrameCallback& frame_cb,
+		     ModeResult& mode_res)
+{
+  TrigMode trig_mode;
+  if(!get_trig_mode(mode_res.trig_mode,trig_mode))
+    {
+      mode_res.error = "Invalid trigger mode";
+      return;
+    }
+  try
+    {
+      cam.setTrigMode(trig_mode);
+      double last_frame_time = -1.;
+      for(int i = 0;i < opt.nb_acq;++i)
+	{
+	  AcqResult res;
+	  run_acquisition(cam,opt,frame_cb,last_frame_time,res,mode_res.latency);
+	  mode_res.acqs.push_back(res);
+	  if(res.fault)
+	    break;
+	}
+    }
+  catch(Exception& e)
+    {
+      mode_res.error = e.getErrMsg();
+    }
+}
+
+//-----------------------------------------------------
+// JSON report
+//-----------------------------------------------------
+static std::string json_string(const std::string& value)
+{
+  std::string s = "\"";
+  for(std::string::const_iterator i = value.begin();i != value.end();++i)
+    {
+      if(*i == '"' || *i == '\\')
+	s += '\\';
+      if((unsigned char)*i < 0x20)
+	s += ' ';
+      else
+	s += *i;
+    }
+  return s + "\"";
+}
+
+// min, mean and max of the acquisitions, negative values are skipped
+static void print_summary(FILE* f,const char* name,
+			  const std::vector<AcqResult>& acqs,
+			  double AcqResult::*field)
+{
+  double min_value = 0.,max_value = 0.,sum = 0.;
+  int count = 0;
+  for(std::vector<AcqResult>::const_iterator i = acqs.begin();i != acqs.end();++i)
+    {
+      double value = (*i).*field;
+      if(value < 0.)
+	continue;
+      if(!count || value < min_value) min_value = value;
+      if(!count || value > max_value) max_value = value;
+      sum += value;
+      ++count;
+    }
+  fprintf(f,"      \"%s\": {\"min\": %g, \"mean\": %g, \"max\": %g},\n",
+	  name,min_value,count ? sum / count : 0.,max_value);
+}
+
+static void print_report(FILE* f,Camera& cam,const BenchOptions& opt,
+			 const std::vector<ModeResult>& modes)
+{
+  std::string model;
+  cam.getDetectorModel(model);
+  Camera::Transport transport;
+  cam.getTransport(transport);
+  Roi roi;
+  cam.getRoi(roi);
+  Bin bin;
+  cam.getBin(bin);
+  ImageType type;
+  cam.getImageType(type);
+  double exp_time,lat_time;
+  cam.getExpTime(exp_time);
+  cam.getLatTime(lat_time);
+  Camera::StreamStatistics stats;
+  cam.getStreamStatistics(stats);
+
+  fprintf(f,"{\n  \"camera\": {\"id\": %s, \"model\": %s, \"transport\": \"%s\"},\n",
+	  json_string(opt.camera_id).c_str(),json_string(model).c_str(),
+	  transport == Camera::Usb ? "USB" : "GigE");
+  fprintf(f,"  \"settings\": {\"roi\": [%d, %d, %d, %d], \"bin\": [%d, %d], "
+	  "\"bpp\": %d, \"packet_size\": %d, \"exposure\": %g, \"latency_time\": %g, "
+	  "\"frames\": %d, \"acquisitions\": %d, \"buffers\": %d},\n",
+	  roi.getTopLeft().x,roi.getTopLeft().y,
+	  roi.getSize().getWidth(),roi.getSize().getHeight(),
+	  bin.getX(),bin.getY(),FrameDim::getImageTypeBpp(type),
+	  opt.packet_size,exp_time,lat_time,
+	  opt.nb_frames,opt.nb_acq,opt.nb_buffers);
+  fprintf(f,"  \"modes\": [");
+  for(std::vector<ModeResult>::const_iterator m = modes.begin();m != modes.end();++m)
+    {
+      fprintf(f,"%s\n    {\n      \"trig_mode\": %s,\n",
+	      m == modes.begin() ? "" : ",",json_string(m->trig_mode).c_str());
+      if(!m->error.empty())
+	fprintf(f,"      \"error\": %s,\n",json_string(m->error).c_str());
+      long lost_frames = 0,failed_buffers = 0,lost_packets = 0,resend_requests = 0;
+      for(std::vector<AcqResult>::const_iterator a = m->acqs.begin();a != m->acqs.end();++a)
+	{
+	  lost_frames += a->lost_frames;
+	  failed_buffers += a->failed_buffers;
+	  lost_packets += a->lost_packets;
+	  resend_requests += a->resend_requests;
+	}
+      fprintf(f,"      \"lost_frames\": %ld, \"failed_buffers\": %ld, "
+	      "\"lost_packets\": %ld, \"resend_requests\": %ld,\n",
+	      lost_frames,failed_buffers,lost_packets,resend_requests);
+      print_summary(f,"fps",m->acqs,&AcqResult::fps);
+      print_summary(f,"dead_time",m->acqs,&AcqResult::dead_time);
+      print_summary(f,"rearm_time",m->acqs,&AcqResult::rearm_time);
+      fprintf(f,"      \"latency\": {");
+      for(int i = 0;i < Camera::NB_LATENCY_STAGE;++i)
+	{
+	  const LatencyHistogram& h = m->latency[i];
+	  fprintf(f,"%s\n        \"%s\": {\"count\": %ld, \"min\": %g, \"mean\": %g, "
+		  "\"p50\": %g, \"p90\": %g, \"p99\": %g, \"p999\": %g, \"max\": %g}",
+		  i ? "," : "",StageNames[i],h.getCount(),h.getMin(),h.getMean(),
+		  h.getPercentile(50.),h.getPercentile(90.),h.getPercentile(99.),
+		  h.getPercentile(99.9),h.getMax());
+	}
+      fprintf(f,"\n      },\n      \"acquisitions\": [");
+      for(std::vector<AcqResult>::const_iterator a = m->acqs.begin();a != m->acqs.end();++a)
+	fprintf(f,"%s\n        {\"frames\": %ld, \"delivered_frames\": %ld, "
+		"\"lost_frames\": %ld, \"fps\": %g, "
+		"\"dead_time\": %g, \"rearm_time\": %g, \"failed_buffers\": %ld, "
+		"\"lost_packets\": %ld, \"fault\": %s}",
+		a == m->acqs.begin() ? "" : ",",a->nb_frames,a->delivered_frames,
+		a->lost_frames,a->fps,
+		a->dead_time,a->rearm_time,a->failed_buffers,a->lost_packets,
+		a->fault ? "true" : "false");
+      fprintf(f,"\n      ]\n    }");
+    }
+  fprintf(f,"\n  ]\n}\n");
+}
+
+int main(int argc,char* argv[])
+{
+  BenchOptions opt;
+  if(!parse_options(argc,argv,opt))
+    {
+      usage(argv[0]);
+      return 2;
+    }
+
+  try
+    {
+      Camera cam(opt.camera_id,opt.packet_size);
+      bool color_flag;
+      cam.isColor(color_flag);
+      if(color_flag)
+	throw LIMA_HW_EXC(NotSupported,"Color cameras are not supported");
+      configure(cam,opt);
+      BenchFrameCallback frame_cb;
+      alloc_buffers(cam,opt,frame_cb);
+
+      std::vector<ModeResult> modes(opt.trig_modes.size());
+      for(unsigned int i = 0;i < opt.trig_modes.size();++i)
+	{
+	  modes[i].trig_mode = opt.trig_modes[i];
+	  run_mode(cam,opt,frame_cb,modes[i]);
+	}
+
+      FILE* f = stdout;
+      if(!opt.output.empty() && !(f = fopen(opt.output.c_str(),"w")))
+	{
+	  perror(opt.output.c_str());
+	  return 1;
+	}
+      print_report(f,cam,opt,modes);
+      if(f != stdout)
+	fclose(f);
+    }
+  catch(Exception& e)
+    {
+      fprintf(stderr,"%s\n",e.getErrMsg().c_str());
+      return 1;
+    }
+  catch(GenICam::GenericException& e)
+    {
+      fprintf(stderr,"%s\n",e.GetDescription());
+      return 1;
+    }
+  return 0;
+}
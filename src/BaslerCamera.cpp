@@ -21,15 +21,22 @@
 //###########################################################################
 #ifdef WIN32
 #include <winsock2.h>
+#include <ws2tcpip.h>
+#include <direct.h>
 #endif
 
 #include <sstream>
 #include <iostream>
 #include <string>
+#include <vector>
 #include <algorithm>
 #include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fstream>
 #include "BaslerCamera.h"
 #include "BaslerVideoCtrlObj.h"
+#include <pylon/FeaturePersistence.h>
 
 using namespace lima;
 using namespace lima::Basler;
@@ -40,34 +47,321 @@ using namespace std;
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
 #define min(A,B) std::min(A,B)
 #define max(A,B) std::max(A,B)
 #endif
 
 const static int DEFAULT_TIME_OUT = 600000; // 10 minutes
+const static double DEFAULT_STATS_PERIOD = 1.; // 1 second
+const static int DEFAULT_WATCHDOG_MISSED_FRAMES = 5;
+const static int MIN_WATCHDOG_TIME_OUT = 50; // ms, host scheduling margin
+const static double DEFAULT_RECONNECT_TIME_OUT = 60.; // 1 minute
+const static unsigned long RECONNECT_RETRY_DELAY = 500; // ms
+const static int NB_TUNE_BUFFER = 16;
+const static int NB_RAW_BUFFER = 16;
+const static int DEFAULT_RAW_STREAM_BUFFERS = 64;
+const static int DEFAULT_SHM_NB_SLOTS = 32;
+const static int DEFAULT_TRACE_RING_SIZE = 8192;
+const static int MAX_ROI_OFFSETS = 4096;
+
+// Per frame debug messages cost a formatting check even when the debug
+// is off, they are only compiled in with BASLER_DEBUG_HOT_PATH. The
+// acquisition events are recorded in m_trace_ring instead.
+#ifdef BASLER_DEBUG_HOT_PATH
+#define DEB_HOT_TRACE() DEB_TRACE()
+#else
+#define DEB_HOT_TRACE() while(false) DEB_TRACE()
+#endif
+const static int DEFAULT_PROCESSING_THREADS = 4;
 
 //---------------------------
 //- utility function
 //---------------------------
-static inline const char* _get_ip_addresse(const char *name_ip)
+// getaddrinfo is used as it's reentrant, cameras may be opened in parallel
+static inline std::string _get_ip_addresse(const char *name_ip)
 {
   
   if(inet_addr(name_ip) != INADDR_NONE)
     return name_ip;
   else
     {
-      struct hostent *host = gethostbyname(name_ip);
-      if(!host)
+      struct addrinfo hints;
+      memset(&hints,0,sizeof(hints));
+      hints.ai_family = AF_INET;
+      struct addrinfo *res;
+      char ip[INET_ADDRSTRLEN];
+      if(getaddrinfo(name_ip,NULL,&hints,&res))
     {
       char buffer[256];
       snprintf(buffer,sizeof(buffer),"Can not found ip for host %s ",name_ip);
       throw LIMA_HW_EXC(Error,buffer);
     }
-      return inet_ntoa(*((struct in_addr*)host->h_addr));
+      getnameinfo(res->ai_addr,res->ai_addrlen,ip,sizeof(ip),NULL,0,NI_NUMERICHOST);
+      freeaddrinfo(res);
+      return ip;
+    }
+}
+
+#ifdef __unix
+// cpu list is a comma separated list of cpu or cpu ranges, i.e: "0,2,4-7"
+static void _parse_cpu_list(const std::string& cpu_list,cpu_set_t& cpu_set)
+{
+  CPU_ZERO(&cpu_set);
+  int nb_cpus = int(sysconf(_SC_NPROCESSORS_ONLN));
+  std::istringstream cpu_stream(cpu_list);
+  std::string token;
+  while(std::getline(cpu_stream,token,','))
+    {
+      std::istringstream range(token);
+      int first,last;
+      char dash;
+      if(!(range >> first))
+	throw LIMA_HW_EXC(InvalidValue,"Invalid cpu list: " + cpu_list);
+      if(range >> dash)
+	{
+	  if(dash != '-' || !(range >> last))
+	    throw LIMA_HW_EXC(InvalidValue,"Invalid cpu list: " + cpu_list);
+	}
+      else
+	last = first;
+      if(first < 0 || first > last || last >= nb_cpus)
+	throw LIMA_HW_EXC(InvalidValue,"Cpu out of range in: " + cpu_list);
+      for(int cpu = first;cpu <= last;++cpu)
+	CPU_SET(cpu,&cpu_set);
+    }
+}
+
+static std::string _cpu_set_to_string(const cpu_set_t& cpu_set)
+{
+  std::ostringstream cpu_list;
+  int nb_cpus = int(sysconf(_SC_NPROCESSORS_ONLN));
+  for(int cpu = 0;cpu < nb_cpus;++cpu)
+    if(CPU_ISSET(cpu,&cpu_set))
+      {
+	if(cpu_list.tellp() > 0) cpu_list << ',';
+	cpu_list << cpu;
+      }
+  return cpu_list.str();
+}
+
+static int _get_sched_policy(Camera::ThreadPolicy policy)
+{
+  switch(policy)
+    {
+    case Camera::SchedFifo:	return SCHED_FIFO;
+    case Camera::SchedRR:	return SCHED_RR;
+    default:			return SCHED_OTHER;
+    }
+}
+
+static void _check_sched_priority(Camera::ThreadPolicy policy,int priority)
+{
+  int sched_policy = _get_sched_policy(policy);
+  int min_priority = sched_get_priority_min(sched_policy);
+  int max_priority = sched_get_priority_max(sched_policy);
+  if(priority < min_priority || priority > max_priority)
+    {
+      std::ostringstream msg;
+      msg << "Acquisition thread priority must be in ["
+	  << min_priority << ',' << max_priority << "]";
+      throw LIMA_HW_EXC(InvalidValue,msg.str());
+    }
+}
+
+// Threads inherit the affinity of their creator, the calling thread
+// gets the requested affinity while Pylon creates its receive thread.
+class _ThreadAffinityGuard
+{
+public:
+  _ThreadAffinityGuard(const std::string& cpu_list) : m_restore(false)
+  {
+    if(cpu_list.empty()) return;
+    cpu_set_t cpu_set;
+    _parse_cpu_list(cpu_list,cpu_set);
+    pthread_getaffinity_np(pthread_self(),sizeof(m_saved),&m_saved);
+    m_restore = !pthread_setaffinity_np(pthread_self(),sizeof(cpu_set),&cpu_set);
+  }
+  ~_ThreadAffinityGuard()
+  {
+    if(m_restore)
+      pthread_setaffinity_np(pthread_self(),sizeof(m_saved),&m_saved);
+  }
+private:
+  cpu_set_t	m_saved;
+  bool		m_restore;
+};
+#else
+class _ThreadAffinityGuard
+{
+public:
+  _ThreadAffinityGuard(const std::string&) {}
+};
+#endif
+
+// Stream grabber tuning profiles, -1 keeps the Pylon default.
+// socket buffer (KB), resend timeout (ms), resend request threshold (%),
+// receive window (packets), packet timeout (ms), frame retention (ms),
+// then for USB: max transfer size (bytes) and max queued urbs
+static const struct
+{
+  const char*	name;
+  long		values[Camera::NB_STREAM_PARAMETERS];
+} StreamProfiles[] = {
+  {"default",			{-1,-1,-1,-1,-1,-1,-1,-1}},
+  // detect losses early and drop incomplete frames quickly
+  {"low-latency",		{4096,2,5,16,10,50,65536,64}},
+  // large socket buffer and receive window, be patient with resends
+  {"lossless-high-throughput",	{16384,5,20,64,40,200,1048576,128}},
+  // links shared by several cameras: tolerate bursts of other streams
+  {"many-cameras",		{8192,10,10,32,80,500,262144,32}},
+  {NULL,			{0,0,0,0,0,0,0,0}}
+};
+
+static const char* StreamParameterNames[] = {
+  "SocketBufferSize","ResendTimeout","ResendRequestThreshold",
+  "ReceiveWindowSize","PacketTimeout","FrameRetention",
+  "MaxTransferSize","NumMaxQueuedUrbs"
+};
+
+// GigE cameras use the "Abs" feature names, USB3 Vision cameras the SFNC ones
+static GenApi::INode* _get_node(GenApi::INodeMap& nodemap,const char* gige_name,
+				const char* usb_name)
+{
+  GenApi::INode* node = nodemap.GetNode(gige_name);
+  if(!node || !GenApi::IsAvailable(node))
+    node = nodemap.GetNode(usb_name);
+  return node;
+}
+
+// Directory of the host side per camera settings
+static std::string _get_config_dir()
+{
+  const char* dir = getenv("LIMA_BASLER_CONFIG_DIR");
+  if(dir && *dir) return dir;
+#ifdef __unix
+  const char* home = getenv("HOME");
+#else
+  const char* home = getenv("USERPROFILE");
+#endif
+  return std::string(home ? home : ".") + "/.lima/basler";
+}
+
+static void _make_dirs(const std::string& path)
+{
+  for(std::string::size_type pos = path.find('/',1);;pos = path.find('/',pos + 1))
+    {
+      std::string dir = path.substr(0,pos);
+#ifdef __unix
+      mkdir(dir.c_str(),0755);
+#else
+      _mkdir(dir.c_str());
+#endif
+      if(pos == std::string::npos) break;
+    }
+}
+
+// Set a stream grabber parameter by name clipped to its range,
+// return the value in effect or -1 if not available.
+static long _set_stream_param(GenApi::INodeMap* nodemap,const char* name,long value)
+{
+  GenApi::CIntegerPtr param = nodemap->GetNode(name);
+  if(!param.IsValid() || !GenApi::IsReadable(param))
+    return -1;
+  if(value >= 0 && GenApi::IsWritable(param))
+    {
+      int64_t v = max(param->GetMin(),min(param->GetMax(),int64_t(value)));
+      int64_t inc = param->GetInc();
+      if(inc > 1) v -= (v - param->GetMin()) % inc;
+      param->SetValue(v);
+    }
+  return long(param->GetValue());
+}
+
+// Stream grabber parameter needed for grabbing, the GigE and USB
+// stream grabbers both have it under the same name.
+static void _set_grabber_param(IStreamGrabber* grabber,const char* name,int64_t value)
+{
+  GenApi::CIntegerPtr param = grabber->GetNodeMap()->GetNode(name);
+  if(!param.IsValid() || !GenApi::IsWritable(param))
+    throw LIMA_HW_EXC(Error,std::string("Can't set stream grabber ") + name);
+  param->SetValue(value);
+}
+
+// Correction of a part of the frame, parts are aligned on 16 pixels
+class _CorrectionTask : public WorkerPool::Task
+{
+public:
+  _CorrectionTask(const Correction& correction,const void* src,void* dst,
+		  int depth,int max_value) :
+    m_correction(correction),m_src(src),m_dst(dst),m_depth(depth),m_max_value(max_value) {}
+
+  virtual void process(int part,int nb_parts)
+  {
+    long nb_pixels = m_correction.getNbPixels();
+    int begin = int(nb_pixels * part / nb_parts) & ~15;
+    int end = part == nb_parts - 1 ? int(nb_pixels) : int(nb_pixels * (part + 1) / nb_parts) & ~15;
+    m_correction.correct(m_src,m_dst,m_depth,m_max_value,begin,end);
+  }
+
+private:
+  const Correction&	m_correction;
+  const void*		m_src;
+  void*			m_dst;
+  int			m_depth;
+  int			m_max_value;
+};
+
+template<class T>
+static void _copy_table(const T* src,int nb,std::vector<float>& table)
+{
+  table.resize(nb);
+  for(int i = 0;i < nb;++i)
+    table[i] = float(src[i]);
+}
+
+// Convert a correction image into a float table of width x height
+static void _data_to_table(const Data& data,int width,int height,std::vector<float>& table)
+{
+  table.clear();
+  if(data.empty()) return;
+  if(data.dimensions.size() != 2 ||
+     data.dimensions[0] != width || data.dimensions[1] != height)
+    throw LIMA_HW_EXC(InvalidValue,"Correction image size doesn't match the image size");
+
+  int nb = width * height;
+  void* ptr = data.data();
+  switch(data.type)
+    {
+    case Data::UINT8:	_copy_table((unsigned char*)ptr,nb,table);	break;
+    case Data::INT8:	_copy_table((char*)ptr,nb,table);		break;
+    case Data::UINT16:	_copy_table((unsigned short*)ptr,nb,table);	break;
+    case Data::INT16:	_copy_table((short*)ptr,nb,table);		break;
+    case Data::UINT32:	_copy_table((unsigned int*)ptr,nb,table);	break;
+    case Data::INT32:	_copy_table((int*)ptr,nb,table);		break;
+    case Data::FLOAT:	_copy_table((float*)ptr,nb,table);		break;
+    case Data::DOUBLE:	_copy_table((double*)ptr,nb,table);		break;
+    default:
+      throw LIMA_HW_EXC(InvalidValue,"Correction image type not supported");
     }
 }
 
+// Stream grabber counters are read by name, depending on the Pylon
+// version some of them are not available, in that case -1 is returned.
+static inline long _get_stream_counter(GenApi::INodeMap* nodemap,const char* name)
+{
+  GenApi::CIntegerPtr counter = nodemap->GetNode(name);
+  if(counter.IsValid() && GenApi::IsReadable(counter))
+    return long(counter->GetValue());
+  else
+    return -1;
+}
+
 
 //---------------------------
 //- utility thread
@@ -87,58 +381,165 @@ class Camera::_AcqThread : public Thread
         Camera&    m_cam;
 };
 
+class Camera::_OpenThread : public Thread
+{
+    DEB_CLASS_NAMESPC(DebModCamera, "Camera", "_OpenThread");
+    public:
+        _OpenThread(Camera &aCam) : m_cam(aCam) {}
+    virtual ~_OpenThread() {join();}
+
+    protected:
+        virtual void threadFunction();
+
+    private:
+        Camera&    m_cam;
+};
+
 
 //---------------------------
 //- Ctor
 //---------------------------
-Camera::Camera(const std::string& camera_ip,int packet_size,int receive_priority)
-        : m_nb_frames(1),
+Camera::Camera(const std::string& camera_id,int packet_size,int receive_priority,
+	       bool lazy_open)
+        : m_buffer_ctrl_obj(*this),
+          m_nb_frames(1),
           m_status(Ready),
           m_wait_flag(true),
           m_quit(false),
           m_thread_running(true),
           m_image_number(0),
+          m_nb_acquired_frames(0),
+          m_nb_frame_waiters(0),
+          m_acq_pending(false),
           m_exp_time(1.),
           m_timeout(DEFAULT_TIME_OUT),
+          m_trig_mode(IntTrig),
+          m_watchdog_missed_frames(DEFAULT_WATCHDOG_MISSED_FRAMES),
+          m_ext_trig_timeout(0.),
+          m_heartbeat_period(0.),
+          m_watchdog_timeout(DEFAULT_TIME_OUT),
           m_latency_time(0.),
+          m_live_grab_strategy(OneByOne),
+          m_skipped_frames(0),
+          m_auto_reconnect(false),
+          m_auto_resume(false),
+          m_reconnect_timeout(DEFAULT_RECONNECT_TIME_OUT),
+          m_device_removed(false),
           Camera_(NULL),
           StreamGrabber_(NULL),
+          m_acq_thread(NULL),
+          m_open_thread(NULL),
+          m_opened(false),
           m_receive_priority(receive_priority),
-	  m_video(NULL)
+          m_effective_receive_priority(0),
+          m_acq_thread_policy(SchedOther),
+          m_acq_thread_priority(0),
+          m_acq_thread_settings_changed(false),
+          m_effective_acq_thread_policy(SchedOther),
+          m_effective_acq_thread_priority(0),
+          m_packet_size(packet_size),
+          m_color_flag(false),
+	  m_color_last(-1),
+	  m_nb_pinned_frames(0),
+	  m_video(NULL),
+	  m_interface_created(false),
+	  m_stats_period(DEFAULT_STATS_PERIOD),
+	  m_stream_profile("default"),
+	  m_tuned_packet_size(-1),
+	  m_tuned_inter_packet_delay(-1),
+	  m_cam_tick_period(0.),
+	  m_cam_time_offset(0.),
+	  m_correction_active(false),
+	  m_process_depth(2),
+	  m_process_max_value(0xffff),
+	  m_beam_monitor_active(false),
+	  m_beam_store_frames(true),
+	  m_raw_stream_buffers(DEFAULT_RAW_STREAM_BUFFERS),
+	  m_raw_write_callback(*this),
+	  m_shm_nb_slots(DEFAULT_SHM_NB_SLOTS),
+	  m_roi_move_pending(false)
 {
     DEB_CONSTRUCTOR();
-    m_camera_ip = camera_ip;
+    m_config.valid = false;
+    for(int i = 0;i < NB_STREAM_PARAMETERS;++i)
+      m_stream_params[i] = m_effective_stream_params[i] = -1;
+    _resetStreamStatistics();
+    m_camera_id = camera_id;
+    m_transport = GigE;
+    m_worker_pool.setNbThreads(DEFAULT_PROCESSING_THREADS);
+    m_trace_ring.setSize(DEFAULT_TRACE_RING_SIZE);
+    for(int i = 0;i < NB_COLOR_BUFFER;++i)
+    {
+      m_color_buffer[i] = NULL;
+      m_color_queued[i] = false;
+      m_color_pins[i] = 0;
+      m_color_buffer_frames[i] = -1;
+      m_color_frames[i].ptr = NULL;
+    }
+    m_startup_time.resolve = m_startup_time.create = m_startup_time.configure = 0.;
+
+    // Pylon initialization is reference counted, it's done here so
+    // devices can then be opened in parallel
+    Pylon::PylonInitialize( );
+    WaitObject_ = WaitObjectEx::Create();
+    m_raw_write_done = WaitObjectEx::Create();
+    m_raw_writer.setCallback(&m_raw_write_callback);
+
+    if(!lazy_open)
+    {
+	try
+	{
+	    open();
+	}
+	catch (...)
+	{
+	    Pylon::PylonTerminate( );
+	    throw;
+	}
+    }
+}
+
+//---------------------------
+//- Camera::open()
+// Open and configure the camera, nothing is done if already opened.
+// With several cameras, use openAsync() on each of them then
+// waitOpened() to open them in parallel. The device lock is held
+// until the camera is configured, control calls made meanwhile wait.
+//---------------------------
+void Camera::open()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    if(m_opened) return;
+
     try
     {
-        Pylon::PylonInitialize( );
+        Timestamp start = Timestamp::now();
         // Create the transport layer object needed to enumerate or
         // create a camera object of type Camera_t::DeviceClass()
         DEB_TRACE() << "Create a camera object of type Camera_t::DeviceClass()";
         CTlFactory& TlFactory = CTlFactory::GetInstance();
 
-        // camera_ip is not really necessarily an IP, it may also be a DNS name
-        // pylon_camera_ip IS an IP
-        Pylon::String_t pylon_camera_ip(_get_ip_addresse(m_camera_ip.c_str()));
+        CDeviceInfo di;
+        _findDevice(di);
+        m_startup_time.resolve = Timestamp::now() - start;
+        start = Timestamp::now();
 
-        //- Find the Pylon device thanks to its IP Address
-        CBaslerGigEDeviceInfo di;
-        di.SetIpAddress( pylon_camera_ip);
-        DEB_TRACE() << "Create the Pylon device attached to ip address : " << DEB_VAR1(m_camera_ip);
+        DEB_TRACE() << "Create the Pylon device attached to : " << DEB_VAR1(m_camera_id);
         IPylonDevice* device = TlFactory.CreateDevice( di);
         if (!device)
-        {
-            Pylon::PylonTerminate( );
-            THROW_HW_ERROR(Error) << "Unable to find camera with selected IP!";
-        }
+            THROW_HW_ERROR(Error) << "Unable to find camera " << m_camera_id;
 
         //- Create the Basler Camera object
         DEB_TRACE() << "Create the Camera object corresponding to the created Pylon device";
         Camera_ = new Camera_t(device);
         if(!Camera_)
-        {
-            Pylon::PylonTerminate( );
             THROW_HW_ERROR(Error) << "Unable to get the camera from transport_layer!";
-        }
+
+        //- Keep the device identity for a later reconnection
+        m_device_info = Camera_->GetDeviceInfo();
+        m_transport = m_device_info.GetDeviceClass() == "BaslerUsb" ? Usb : GigE;
+        _loadStreamProfile();
 
         //- Get detector model and type
         m_detector_type  = Camera_->GetDeviceInfo().GetVendorName();
@@ -157,9 +558,20 @@ Camera::Camera(const std::string& camera_ip,int packet_size,int receive_priority
         // Open the camera
         DEB_TRACE() << "Open camera";        
         Camera_->Open();
+        _registerRemovalCallback();
+        _resolveFeatures();
+        m_startup_time.create = Timestamp::now() - start;
+        start = Timestamp::now();
     
-        if(packet_size > 0)
-          Camera_->GevSCPSPacketSize.SetValue(packet_size);
+        if(m_transport == GigE)
+        {
+            if(m_packet_size > 0)
+              Camera_->GevSCPSPacketSize.SetValue(m_packet_size);
+            else if(m_tuned_packet_size > 0)
+              Camera_->GevSCPSPacketSize.SetValue(m_tuned_packet_size);
+            if(m_tuned_inter_packet_delay >= 0)
+              Camera_->GevSCPD.SetValue(m_tuned_inter_packet_delay);
+        }
     
         // Set the image format and AOI
         DEB_TRACE() << "Set the image format and AOI";
@@ -202,8 +614,9 @@ Camera::Camera(const std::string& camera_ip,int packet_size,int receive_priority
 
         // Set the camera to continuous frame mode
         DEB_TRACE() << "Set the camera to continuous frame mode";
-        Camera_->TriggerSelector.SetValue(TriggerSelector_AcquisitionStart);
+        _selectAcquisitionStartTrigger();
         Camera_->AcquisitionMode.SetValue(AcquisitionMode_Continuous);
+        getTrigMode(m_trig_mode);
         
         if ( GenApi::IsAvailable(Camera_->ExposureAuto ))
         {
@@ -214,25 +627,94 @@ Camera::Camera(const std::string& camera_ip,int packet_size,int receive_priority
         // Get the image buffer size
         DEB_TRACE() << "Get the image buffer size";
         ImageSize_ = (size_t)(Camera_->PayloadSize.GetValue());
-           
-        WaitObject_ = WaitObjectEx::Create();
     
+        if(m_color_flag)
+          _initColorStreamGrabber(true);
+        _saveConfig();
+
         m_acq_thread = new _AcqThread(*this);
         m_acq_thread->start();
+        m_startup_time.configure = Timestamp::now() - start;
     }
     catch (GenICam::GenericException &e)
     {
         // Error handling
-        Pylon::PylonTerminate( );
+        _releaseDevice();
+        _freeColorBuffers();
         THROW_HW_ERROR(Error) << e.GetDescription();
     }
-    if(m_color_flag)
-      _initColorStreamGrabber(true);
-    else
-      {
-	for(int i = 0;i < NB_COLOR_BUFFER;++i)
-	  m_color_buffer[i] = NULL;
-      }
+    catch (Exception&)
+    {
+        _releaseDevice();
+        _freeColorBuffers();
+        throw;
+    }
+    m_opened = true;
+    DEB_TRACE() << "Camera opened, " << DEB_VAR3(m_startup_time.resolve,
+						 m_startup_time.create,
+						 m_startup_time.configure);
+}
+
+//---------------------------
+//- Camera::openAsync()
+// Start the open phase in a separate thread
+//---------------------------
+void Camera::openAsync()
+{
+    DEB_MEMBER_FUNCT();
+    if(m_opened || m_open_thread) return;
+
+    m_open_error.clear();
+    m_open_thread = new _OpenThread(*this);
+    m_open_thread->start();
+}
+
+//---------------------------
+//- Camera::waitOpened()
+// Wait the end of openAsync(), or open the camera if not started
+//---------------------------
+void Camera::waitOpened()
+{
+    DEB_MEMBER_FUNCT();
+    if(m_open_thread)
+    {
+	delete m_open_thread;		// join
+	m_open_thread = NULL;
+	if(!m_open_error.empty())
+	  THROW_HW_ERROR(Error) << m_open_error;
+    }
+    open();
+}
+
+void Camera::isOpened(bool& opened) const
+{
+    opened = m_opened;
+}
+
+//---------------------------
+//- Camera::getStartupTime()
+// Time (in second) spent in each phase of the open
+//---------------------------
+void Camera::getStartupTime(double& resolve,double& create,double& configure) const
+{
+    DEB_MEMBER_FUNCT();
+    resolve = m_startup_time.resolve;
+    create = m_startup_time.create;
+    configure = m_startup_time.configure;
+    DEB_RETURN() << DEB_VAR3(resolve,create,configure);
+}
+
+void Camera::_OpenThread::threadFunction()
+{
+    DEB_MEMBER_FUNCT();
+    try
+    {
+	m_cam.open();
+    }
+    catch (Exception &e)
+    {
+	m_cam.m_open_error = e.getErrMsg();
+    }
 }
 
 //---------------------------
@@ -241,6 +723,7 @@ Camera::Camera(const std::string& camera_ip,int packet_size,int receive_priority
 Camera::~Camera()
 {
     DEB_DESTRUCTOR();
+    delete m_open_thread;
     try
     {
         // Stop Acq thread
@@ -253,84 +736,175 @@ Camera::~Camera()
 
         // Close camera
         DEB_TRACE() << "Close camera";
-        delete Camera_;
-        Camera_ = NULL;
-	if (m_color_flag)
-	  for(int i = 0;i < NB_COLOR_BUFFER;++i)
-#ifdef __unix
-	    free(m_color_buffer[i]);
-#else
-	_aligned_free(m_color_buffer[i]);
-#endif
+	_releaseDevice();
     }
     catch (GenICam::GenericException &e)
     {
-        // Error handling
-        Pylon::PylonTerminate( );
-        THROW_HW_ERROR(Error) << e.GetDescription();
+        // Error handling, a destructor must not throw
+        DEB_ERROR() << e.GetDescription();
+    }
+    catch (Exception &e)
+    {
+        DEB_ERROR() << e.getErrMsg();
     }
+    _freeColorBuffers();
+    _freeRawBuffers();
+    Pylon::PylonTerminate( );
 }
 
 void Camera::prepareAcq()
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    // the views of the last acquisition would be overwritten
+    if(!m_color_flag) _checkNoPinnedFrame();
     m_image_number=0;
+    _publishImageNumber();
+    atomicStore(&m_skipped_frames,0);
+    _resetStreamStatistics();
+    for(int i = 0;i < NB_LATENCY_STAGE;++i)
+      m_latency[i].reset();
+    m_preview.reset();
+    _resetRoiMoves();
+
+    _checkThreadSettings();
+
+    // Without any image delivered, the Lima control layer would wait
+    // forever for the end of a fixed length acquisition.
+    if(m_interface_created && m_nb_frames &&
+       (!m_raw_stream_file.empty() || (m_beam_monitor_active && !m_beam_store_frames)))
+      THROW_HW_ERROR(Error) << "Frames are not stored, only a live acquisition "
+			    << "(0 frames) can run under Lima control";
 
     if(m_color_flag)
+    {
+      _setAcqPending(true);
       return;			// Nothing to do if color camera
+    }
 
     try
     {
 	_freeStreamGrabber();
-        // Get the first stream grabber object of the selected camera
-        DEB_TRACE() << "Get the first stream grabber object of the selected camera";
-        StreamGrabber_ = new Camera_t::StreamGrabber_t(Camera_->GetStreamGrabber(0));
-	//Change priority to m_receive_priority
-	if(m_receive_priority > 0)
-	  {
-	    StreamGrabber_->ReceiveThreadPriorityOverride.SetValue(true);
-	    StreamGrabber_->ReceiveThreadPriority.SetValue(m_receive_priority);
-	  }
-        // Open the stream grabber
-        DEB_TRACE() << "Open the stream grabber";
-        StreamGrabber_->Open();
-        if(!StreamGrabber_->IsOpen())
-        {
-            delete StreamGrabber_;
-            StreamGrabber_ = NULL;
-            THROW_HW_ERROR(Error) << "Unable to open the steam grabber!";
-        }
-        // We won't use image buffers greater than ImageSize
-        DEB_TRACE() << "We won't use image buffers greater than ImageSize";
-        StreamGrabber_->MaxBufferSize.SetValue((const size_t)ImageSize_);
-
-        StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj.getBuffer();
-        // We won't queue more than c_nBuffers image buffers at a time
-        int nb_buffers;
-        buffer_mgr.getNbBuffers(nb_buffers);
-        DEB_TRACE() << "We'll queue " << nb_buffers << " image buffers";
-        StreamGrabber_->MaxNumBuffer.SetValue(nb_buffers);
-
-        // Allocate all resources for grabbing. Critical parameters like image
-        // size now must not be changed until FinishGrab() is called.
-        DEB_TRACE() << "Allocate all resources for grabbing, PrepareGrab";
-        StreamGrabber_->PrepareGrab();
-
-        // Put buffer into the grab queue for grabbing
-        DEB_TRACE() << "Put buffer into the grab queue for grabbing";
-        for(int i = 0;i < nb_buffers;++i)
-        {
-            void *ptr = buffer_mgr.getFrameBufferPtr(i);
-            // The registration returns a handle to be used for queuing the buffer.
-            StreamBufferHandle bufferId = StreamGrabber_->RegisterBuffer(ptr,(const size_t)ImageSize_);
-            StreamGrabber_->QueueBuffer(bufferId, NULL);
-        }
+	_freeRawBuffers();
+	ImageType type;
+	_getRawImageType(type);
+	m_process_depth = type == Bpp8 ? 1 : 2;
+	m_process_max_value = type == Bpp8 ? 0xff : type == Bpp10 ? 0x3ff :
+	  type == Bpp12 ? 0xfff : 0xffff;
+	m_process_size = Size(int(Camera_->Width.GetValue()),int(Camera_->Height.GetValue()));
+	{
+	    AutoMutex aLock(m_process_lock);
+	    m_accumulator.prepare(m_process_size.getWidth() * m_process_size.getHeight(),
+				  m_process_depth);
+	    if(m_correction_active &&
+	       (m_correction.getWidth() != m_process_size.getWidth() ||
+		m_correction.getHeight() != m_process_size.getHeight()))
+	      THROW_HW_ERROR(Error) << "Correction tables don't match the image size";
+	    const std::vector<BeamMonitor::Roi>& rois = m_beam_monitor.getRois();
+	    for(size_t i = 0;m_beam_monitor_active && i < rois.size();++i)
+	      if(rois[i].x + rois[i].width > m_process_size.getWidth() ||
+		 rois[i].y + rois[i].height > m_process_size.getHeight())
+		THROW_HW_ERROR(Error) << "Beam monitor roi " << i << " is outside the image";
+	    m_beam_monitor.prepare(m_process_size.getWidth(),m_process_size.getHeight(),
+				   m_process_depth);
+	    int out_depth = m_accumulator.getNbFrames() > 1 ? 4 : m_process_depth;
+	    m_compressed_ring.prepare(m_process_size.getWidth(),m_process_size.getHeight(),
+				      out_depth);
+	    if(m_shm_name.empty() || !m_raw_stream_file.empty())
+	      m_shm_ring.close();
+	    else
+	      m_shm_ring.create(m_shm_name,m_process_size.getWidth(),m_process_size.getHeight(),
+				out_depth,m_shm_nb_slots);
+	}
+	bool beam_monitor_only = m_beam_monitor_active && !m_beam_store_frames;
+	if(!m_raw_stream_file.empty())
+	{
+	    if(m_accumulator.getNbFrames() > 1 || m_correction_active)
+	      THROW_HW_ERROR(Error) << "Raw streaming can't be used with accumulation or correction";
+	    _allocRawBuffers(m_raw_stream_buffers);
+	    m_raw_writer.open(m_raw_stream_file,m_process_size.getWidth(),
+			      m_process_size.getHeight(),m_process_depth,ImageSize_);
+	}
+	else if(m_accumulator.getNbFrames() > 1 || m_correction_active || beam_monitor_only ||
+		_isLatestImageOnly())
+	  _allocRawBuffers(NB_RAW_BUFFER);
+
+	int nb_buffers;
+	m_buffer_ctrl_obj.getBuffer().getNbBuffers(nb_buffers);
+	_initStreamGrabber(0,nb_buffers);
     }
     catch (GenICam::GenericException &e)
     {
         // Error handling
         THROW_HW_ERROR(Error) << e.GetDescription();
     }
+    _setAcqPending(true);
+}
+
+//---------------------------
+//- Camera::_initStreamGrabber()
+// Register all the Lima buffers and queue nb_queued of them
+// starting with first_buffer. With the processing path, the raw
+// buffers are registered instead and all queued.
+//---------------------------
+void Camera::_initStreamGrabber(int first_buffer,int nb_queued)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(first_buffer,nb_queued);
+    // Get the first stream grabber object of the selected camera
+    DEB_TRACE() << "Get the first stream grabber object of the selected camera";
+    StreamGrabber_ = Camera_->GetStreamGrabber(0);
+    _setReceiveThreadPriority();
+    // Open the stream grabber
+    DEB_TRACE() << "Open the stream grabber";
+    _ThreadAffinityGuard affinity(m_receive_affinity);
+    StreamGrabber_->Open();
+    if(!StreamGrabber_->IsOpen())
+    {
+        StreamGrabber_ = NULL;
+        THROW_HW_ERROR(Error) << "Unable to open the steam grabber!";
+    }
+    _applyStreamParameters();
+    // We won't use image buffers greater than ImageSize
+    DEB_TRACE() << "We won't use image buffers greater than ImageSize";
+    _set_grabber_param(StreamGrabber_,"MaxBufferSize",ImageSize_);
+
+    std::vector<void*> buffers = m_raw_buffers;
+    if(buffers.empty())
+    {
+	StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj.getBuffer();
+	int nb_lima_buffers;
+	buffer_mgr.getNbBuffers(nb_lima_buffers);
+	for(int i = 0;i < nb_lima_buffers;++i)
+	  buffers.push_back(buffer_mgr.getFrameBufferPtr(i));
+    }
+    else
+    {
+	first_buffer = 0;
+	nb_queued = int(buffers.size());
+    }
+    // We won't queue more than c_nBuffers image buffers at a time
+    int nb_buffers = int(buffers.size());
+    DEB_TRACE() << "We'll queue " << nb_buffers << " image buffers";
+    _set_grabber_param(StreamGrabber_,"MaxNumBuffer",nb_buffers);
+
+    // Allocate all resources for grabbing. Critical parameters like image
+    // size now must not be changed until FinishGrab() is called.
+    DEB_TRACE() << "Allocate all resources for grabbing, PrepareGrab";
+    StreamGrabber_->PrepareGrab();
+
+    // Put buffer into the grab queue for grabbing
+    DEB_TRACE() << "Put buffer into the grab queue for grabbing";
+    std::vector<StreamBufferHandle> handles(nb_buffers);
+    for(int i = 0;i < nb_buffers;++i)
+    {
+        // The registration returns a handle to be used for queuing the buffer.
+        handles[i] = StreamGrabber_->RegisterBuffer(buffers[i],(const size_t)ImageSize_);
+    }
+    // Buffers are filled in the queue order, so frame n lands in buffer n % nb_buffers
+    for(int i = 0;i < nb_queued && i < nb_buffers;++i)
+        StreamGrabber_->QueueBuffer(handles[(first_buffer + i) % nb_buffers], NULL);
 }
 //---------------------------
 //- Camera::start()
@@ -338,6 +912,8 @@ void Camera::prepareAcq()
 void Camera::startAcq()
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         // Let the camera acquire images continuously ( Acquisiton mode equals Continuous! )
@@ -348,7 +924,12 @@ void Camera::startAcq()
 	else
 	  m_buffer_ctrl_obj.getBuffer().setStartTimestamp(Timestamp::now());
 
+	_saveConfig();
+	_latchCameraClock();
+	_computeWatchdogTimeout();
         Camera_->AcquisitionStart.Execute();
+	BASLER_TRACE(m_trace_ring,TraceAcqStart,m_image_number,m_nb_frames,
+		     Timestamp::now());
 
 	//Start acqusition thread
 	AutoMutex aLock(m_cond.mutex());
@@ -378,7 +959,7 @@ void Camera::_stopAcq(bool internalFlag)
     try
     {
         AutoMutex aLock(m_cond.mutex());
-        if(m_status != Camera::Ready)
+        if(_getStatus() != Camera::Ready)
         {
             while(!internalFlag && m_thread_running)
             {
@@ -390,15 +971,30 @@ void Camera::_stopAcq(bool internalFlag)
 
             //Let the acq thread stop the acquisition
             if(!internalFlag) return;
+            AutoMutex aDeviceLock(m_device_lock);
             
-            // Stop acquisition
-            DEB_TRACE() << "Stop acquisition";
-            Camera_->AcquisitionStop.Execute();
+            // Stop acquisition, the camera is gone if it couldn't be reconnected
+            if(Camera_)
+            {
+                DEB_TRACE() << "Stop acquisition";
+                Camera_->AcquisitionStop.Execute();
+            }
+
+	    // Wait for the frames still to be written
+	    m_raw_writer.close();
+
+	    // Keep the statistics of this acquisition
+	    _sampleStreamStatistics();
 
 	    if(!m_color_flag)
 	      _freeStreamGrabber();
             _setStatus(Camera::Ready,false);
         }
+        else if(!internalFlag && m_wait_flag)
+        {
+            // prepared but not started, release the waiters
+            _setAcqPending(false);
+        }
     }
     catch (GenICam::GenericException &e)
     {
@@ -423,7 +1019,6 @@ void Camera::_freeStreamGrabber()
       DEB_TRACE() << "Free all resources used for grabbing";
       StreamGrabber_->FinishGrab();
       StreamGrabber_->Close();
-      delete StreamGrabber_;
       StreamGrabber_ = NULL;         
     }
 }
@@ -432,16 +1027,18 @@ void Camera::_initColorStreamGrabber(bool allocFlag)
 {
   DEB_MEMBER_FUNCT();
 
-  StreamGrabber_ = new Camera_t::StreamGrabber_t(Camera_->GetStreamGrabber(0));
+  StreamGrabber_ = Camera_->GetStreamGrabber(0);
+  _setReceiveThreadPriority();
+  _ThreadAffinityGuard affinity(m_receive_affinity);
   StreamGrabber_->Open();
   if(!StreamGrabber_->IsOpen())
     {
-      delete StreamGrabber_;
       StreamGrabber_ = NULL;
       THROW_HW_ERROR(Error) << "Unable to open the steam grabber!";
     }
-  StreamGrabber_->MaxBufferSize.SetValue((const size_t)ImageSize_);
-  StreamGrabber_->MaxNumBuffer.SetValue(NB_COLOR_BUFFER);
+  _applyStreamParameters();
+  _set_grabber_param(StreamGrabber_,"MaxBufferSize",ImageSize_);
+  _set_grabber_param(StreamGrabber_,"MaxNumBuffer",NB_COLOR_BUFFER);
   StreamGrabber_->PrepareGrab();
 
   for(int i = 0;i < NB_COLOR_BUFFER;++i)
@@ -452,9 +1049,57 @@ void Camera::_initColorStreamGrabber(bool allocFlag)
 #else
         m_color_buffer[i] = _aligned_malloc(ImageSize_,16);
 #endif
-      StreamBufferHandle bufferId = StreamGrabber_->RegisterBuffer(m_color_buffer[i],
-								   (const size_t)ImageSize_);
-      StreamGrabber_->QueueBuffer(bufferId,NULL);
+      m_color_handles[i] = StreamGrabber_->RegisterBuffer(m_color_buffer[i],
+							   (const size_t)ImageSize_);
+      // a pinned buffer is only queued once unpinned
+      m_color_queued[i] = false;
+      m_color_buffer_frames[i] = -1;
+      if(!m_color_pins[i])
+	_queueColorBuffer(i);
+    }
+  m_color_last = -1;
+}
+
+void Camera::_freeColorBuffers()
+{
+  for(int i = 0;i < NB_COLOR_BUFFER;++i)
+    {
+#ifdef __unix
+      free(m_color_buffer[i]);
+#else
+      _aligned_free(m_color_buffer[i]);
+#endif
+      m_color_buffer[i] = NULL;
+    }
+}
+
+//---------------------------
+//- Camera::_retrieveLatestResult()
+// In LatestImageOnly live mode, all the results already waiting in the
+// output queue are retrieved and only the newest completed one is kept,
+// older ones are re-queued straight away. Frames are grabbed in the raw
+// buffers and the kept one is copied in the next Lima buffer, so the
+// delivered frame numbers stay contiguous.
+//---------------------------
+void Camera::_retrieveLatestResult(GrabResult& Result)
+{
+  DEB_MEMBER_FUNCT();
+  GrabResult newerResult;
+  while(StreamGrabber_->RetrieveResult(newerResult))
+    {
+      if(Grabbed == newerResult.Status())
+	{
+	  StreamGrabber_->QueueBuffer(Result.Handle(),NULL);
+	  atomicAdd(&m_skipped_frames,1);
+	  Result = newerResult;
+	}
+      else
+	{
+	  DEB_WARNING() << "Skip failed frame, error code : 0x"
+			<< hex << newerResult.GetErrorCode();
+	  _setLastErrorCode(long(newerResult.GetErrorCode()));
+	  StreamGrabber_->QueueBuffer(newerResult.Handle(),NULL);
+	}
     }
 }
 
@@ -479,8 +1124,10 @@ void Camera::_AcqThread::threadFunction()
         DEB_TRACE() << "Run";
         m_cam.m_thread_running = true;
         if(m_cam.m_quit) return;
+        if(m_cam.m_acq_thread_settings_changed)
+          m_cam._applyAcqThreadSettings();
     
-        m_cam.m_status = Camera::Exposure;
+        atomicStore(&m_cam.m_status,Camera::Exposure);
         m_cam.m_cond.broadcast();
         aLock.unlock();
 
@@ -489,12 +1136,25 @@ void Camera::_AcqThread::threadFunction()
             WaitObjects waitset;
             waitset.Add(m_cam.WaitObject_);
             waitset.Add(m_cam.StreamGrabber_->GetWaitObject());
+            bool streaming = m_cam.m_raw_writer.isOpen();
+            if(streaming)
+              {
+                m_cam.m_raw_write_done.Reset();
+                waitset.Add(m_cam.m_raw_write_done);
+              }
     
+            // Wake up at least every heartbeat period to check the device
+            int watchdog_timeout = m_cam.m_watchdog_timeout;
+            int heartbeat_period = int(m_cam.m_heartbeat_period * 1e3);
+            int wait_time = (heartbeat_period > 0 && heartbeat_period < watchdog_timeout) ?
+              heartbeat_period : watchdog_timeout;
+            double last_event_time = Timestamp::now();
+
             bool continueAcq = true;
             while(continueAcq && (!m_cam.m_nb_frames || m_cam.m_image_number < m_cam.m_nb_frames))
             {
                 unsigned int event_number;
-                if(waitset.WaitForAny(m_cam.m_timeout,&event_number)) // Wait m_timeout
+                if(waitset.WaitForAny(wait_time,&event_number))
                 {
                     switch(event_number)
                     {
@@ -504,32 +1164,90 @@ void Camera::_AcqThread::threadFunction()
                             aLock.lock();
                             continueAcq = !m_cam.m_wait_flag && !m_cam.m_quit;
                             aLock.unlock();
+                            if(continueAcq && m_cam.m_device_removed)
+                            {
+                                continueAcq = m_cam._recoverDevice(waitset);
+                                if(continueAcq)
+                                  last_event_time = Timestamp::now();
+                                else
+                                  m_cam._setStatus(Camera::Fault,false);
+                            }
+                        break;
+                        case 2:    // raw stream buffers written
+                            {
+                              m_cam.m_raw_write_done.Reset();
+                              m_cam._requeueWrittenBuffers();
+                              std::string error;
+                              if(m_cam.m_raw_writer.getError(error))
+                                {
+                                  DEB_ERROR() << error;
+                                  m_cam._setStatus(Camera::Fault,false);
+                                  continueAcq = false;
+                                }
+                            }
                         break;
                         case 1:
                             // Get the grab result from the grabber's result queue
                             GrabResult Result;
                             m_cam.StreamGrabber_->RetrieveResult(Result);
+			    double retrieve_time = Timestamp::now();
+			    last_event_time = retrieve_time;
+			    BASLER_TRACE(m_cam.m_trace_ring,TraceFrameRetrieved,
+					 m_cam.m_image_number,int(Result.Status()),
+					 retrieve_time);
+			    if(retrieve_time - m_cam.m_stats_sample_time >= m_cam.m_stats_period)
+			      m_cam._sampleStreamStatistics();
+                            if (Grabbed == Result.Status() && m_cam._isLatestImageOnly())
+			      m_cam._retrieveLatestResult(Result);
+
                             if (Grabbed == Result.Status())
                             {
                                 // Grabbing was successful, process image
                                 m_cam._setStatus(Camera::Readout,false);
-                                DEB_TRACE()  << "image#" << DEB_VAR1(m_cam.m_image_number) <<" acquired !";
+                                DEB_HOT_TRACE()  << "image#" << DEB_VAR1(m_cam.m_image_number) <<" acquired !";
+				if(m_cam.m_roi_move_pending)
+				  m_cam._confirmRoiMoves(Result);
+				bool new_frame = true;
 				if(!m_cam.m_color_flag)
 				  {
 				    int nb_buffers;
 				    buffer_mgr.getNbBuffers(nb_buffers);
-				    if (!m_cam.m_nb_frames || 
-					m_cam.m_image_number < int(m_cam.m_nb_frames - nb_buffers))
-				      m_cam.StreamGrabber_->QueueBuffer(Result.Handle(),NULL);
+				    bool store_frame = !streaming &&
+				      (!m_cam.m_beam_monitor_active || m_cam.m_beam_store_frames);
+				    if(streaming)
+				      m_cam._streamFrame(Result,retrieve_time);
+				    else if(!m_cam.m_raw_buffers.empty())
+				      {
+					void* dst = store_frame ?
+					  buffer_mgr.getFrameBufferPtr(m_cam.m_image_number % nb_buffers) : NULL;
+					new_frame = m_cam._processFrame(Result,dst,retrieve_time);
+					m_cam.StreamGrabber_->QueueBuffer(Result.Handle(),NULL);
+				      }
+				    else
+				      {
+					m_cam._processFrame(Result,NULL,retrieve_time);
+					if (!m_cam.m_nb_frames || 
+					    m_cam.m_image_number < int(m_cam.m_nb_frames - nb_buffers))
+					  m_cam.StreamGrabber_->QueueBuffer(Result.Handle(),NULL);
+				      }
+				    double queue_time = Timestamp::now();
                                 
-				    HwFrameInfoType frame_info;
-				    frame_info.acq_frame_nb = m_cam.m_image_number;
-				    continueAcq = buffer_mgr.newFrameReady(frame_info);
-				    DEB_TRACE() << DEB_VAR1(continueAcq);
+				    if(new_frame && store_frame)
+				      {
+					HwFrameInfoType frame_info;
+					frame_info.acq_frame_nb = m_cam.m_image_number;
+					continueAcq = buffer_mgr.newFrameReady(frame_info);
+					DEB_HOT_TRACE() << DEB_VAR1(continueAcq);
+					double delivered_time = Timestamp::now();
+					BASLER_TRACE(m_cam.m_trace_ring,TraceFrameDelivered,
+						     m_cam.m_image_number,continueAcq,
+						     delivered_time);
+					m_cam._recordLatency(Result,retrieve_time,queue_time,
+							     delivered_time);
+				      }
 				  }
 				else
 				  {
-				    m_cam.StreamGrabber_->QueueBuffer(Result.Handle(),NULL);
 				    VideoMode mode;
 				    switch(Result.GetPixelType())
 				      {
@@ -554,14 +1272,30 @@ void Camera::_AcqThread::threadFunction()
 				      case PixelType_BayerBG16:    	mode = BAYER_BG16;	break;
 				      default:
 					DEB_ERROR() << "Image type not managed";
+					m_cam.StreamGrabber_->QueueBuffer(Result.Handle(),NULL);
 					return;
 				      }
+				    // the preview copy is made before the buffer is queued back
+				    if(m_cam.m_preview.isDue(retrieve_time))
+				      m_cam._previewColorFrame(Result,mode,retrieve_time);
+				    {
+				      AutoMutex process_lock(m_cam.m_process_lock);
+				      m_cam._holdColorFrame(Result,mode);
+				    }
+				    double queue_time = Timestamp::now();
 				    m_cam.m_video->callNewImage((char*)Result.Buffer(),
 								Result.GetSizeX(),
 								Result.GetSizeY(),
 								mode);
+				    m_cam._recordLatency(Result,retrieve_time,queue_time,
+							 Timestamp::now());
+				  }
+				if(new_frame)
+				  {
+				    ++m_cam.m_image_number;
+				    m_cam._publishImageNumber();
+				    m_cam.m_notifier.post(NotifyFrame);
 				  }
-                                ++m_cam.m_image_number;
                             }
                             else if (Failed == Result.Status())
                             {
@@ -572,9 +1306,15 @@ void Camera::_AcqThread::threadFunction()
                                             << Result.GetErrorCode()
                                             << " Error description : "
                                             << Result.GetErrorDescription();
+				m_cam._setLastErrorCode(long(Result.GetErrorCode()));
+				BASLER_TRACE(m_cam.m_trace_ring,TraceFrameFailed,
+					     m_cam.m_image_number,int(Result.GetErrorCode()),
+					     retrieve_time);
                                 
                                 if(!m_cam.m_nb_frames) //Do not stop acquisition in "live" mode, just IGNORE  error
                                 {
+                                    // color buffers are also queued back by unpinFrame
+                                    AutoMutex process_lock(m_cam.m_process_lock);
                                     m_cam.StreamGrabber_->QueueBuffer(Result.Handle(), NULL);
                                 }
                                 else            //in "snap" mode , acquisition must be stopped
@@ -586,23 +1326,49 @@ void Camera::_AcqThread::threadFunction()
                         break;
                     }
                 }
-                else
+                else if((double(Timestamp::now()) - last_event_time) * 1e3 >= watchdog_timeout)
                 {
                     // Timeout
-                    DEB_ERROR() << "Timeout occurred!";
-                    m_cam._setStatus(Camera::Fault,false);
-                    continueAcq = false;
+                    DEB_ERROR() << "Timeout occurred! no frame since "
+				<< watchdog_timeout << " ms";
+		    BASLER_TRACE(m_cam.m_trace_ring,TraceTimeout,m_cam.m_image_number,
+				 watchdog_timeout,Timestamp::now());
+                    continueAcq = !m_cam._checkDevice() && m_cam._recoverDevice(waitset);
+                    if(continueAcq)
+                      last_event_time = Timestamp::now();
+                    else
+                      m_cam._setStatus(Camera::Fault,false);
+                }
+                else if(heartbeat_period > 0 && !m_cam._checkDevice())
+                {
+                    continueAcq = m_cam._recoverDevice(waitset);
+                    if(continueAcq)
+                      last_event_time = Timestamp::now();
+                    else
+                      m_cam._setStatus(Camera::Fault,false);
                 }
             }
+            BASLER_TRACE(m_cam.m_trace_ring,TraceAcqEnd,m_cam.m_image_number,
+			 continueAcq,Timestamp::now());
             m_cam._stopAcq(true);
         }
         catch (GenICam::GenericException &e)
         {
             // Error handling
             DEB_ERROR() << "GeniCam Error! "<< e.GetDescription();
+            m_cam._setStatus(Camera::Fault,false);
+        }
+        catch (Exception &e)
+        {
+            DEB_ERROR() << e.getErrMsg();
+            m_cam._setStatus(Camera::Fault,false);
         }
         aLock.lock();
         m_cam.m_wait_flag = true;
+        m_cam.m_notifier.post(NotifyAcqEnd);
+        AutoMutex frame_lock(m_cam.m_frame_cond.mutex());
+        m_cam.m_acq_pending = false;
+        m_cam.m_frame_cond.broadcast();
     }
 }
 
@@ -612,7 +1378,8 @@ void Camera::_AcqThread::threadFunction()
 Camera::_AcqThread::_AcqThread(Camera &aCam) :
                     m_cam(aCam)
 {
-    pthread_attr_setscope(&m_thread_attr,PTHREAD_SCOPE_PROCESS);
+    // system scope, so the thread can be given a real-time scheduling
+    pthread_attr_setscope(&m_thread_attr,PTHREAD_SCOPE_SYSTEM);
 }
 //-----------------------------------------------------
 //
@@ -648,6 +1415,21 @@ void Camera::getDetectorImageSize(Size& size)
 void Camera::getImageType(ImageType& type)
 {
     DEB_MEMBER_FUNCT();
+    if(m_accumulator.getNbFrames() > 1)
+      type = Bpp32;
+    else
+      _getRawImageType(type);
+    DEB_RETURN() << DEB_VAR1(type);
+}
+
+//-----------------------------------------------------
+// Pixel format of the camera
+//-----------------------------------------------------
+void Camera::_getRawImageType(ImageType& type)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         PixelFormatEnums ps = Camera_->PixelFormat.GetValue();
@@ -683,6 +1465,11 @@ void Camera::getImageType(ImageType& type)
 void Camera::setImageType(ImageType type)
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    // accumulated frames are always 32 bits
+    if(type == Bpp32 && m_accumulator.getNbFrames() > 1)
+      return;
     try
     {
         switch( type )
@@ -743,14 +1530,16 @@ void Camera::setTrigMode(TrigMode mode)
 {
     DEB_MEMBER_FUNCT();
     DEB_PARAM() << DEB_VAR1(mode);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
 
     try
     {        
         if ( mode == IntTrig )
         {
             //- INTERNAL 
-            this->Camera_->TriggerSelector.SetValue( TriggerSelector_AcquisitionStart );
-            this->Camera_->TriggerMode.SetValue( TriggerMode_Off );
+            if(_selectAcquisitionStartTrigger())
+                this->Camera_->TriggerMode.SetValue( TriggerMode_Off );
                         
             GenApi::IEnumEntry *enumEntryFrameStart = Camera_->TriggerSelector.GetEntryByName("FrameStart");                    
             if(enumEntryFrameStart && GenApi::IsAvailable(enumEntryFrameStart))            
@@ -762,8 +1551,8 @@ void Camera::setTrigMode(TrigMode mode)
         else if ( mode == ExtGate )
         {
             //- EXTERNAL - TRIGGER WIDTH
-            this->Camera_->TriggerSelector.SetValue( TriggerSelector_AcquisitionStart );
-            this->Camera_->TriggerMode.SetValue( TriggerMode_On );
+            if(_selectAcquisitionStartTrigger())
+                this->Camera_->TriggerMode.SetValue( TriggerMode_On );
             
             GenApi::IEnumEntry *enumEntryFrameStart = Camera_->TriggerSelector.GetEntryByName("FrameStart");                    
             if(enumEntryFrameStart && GenApi::IsAvailable(enumEntryFrameStart))                    
@@ -777,8 +1566,8 @@ void Camera::setTrigMode(TrigMode mode)
         {
             //- EXTERNAL - TIMED
             
-            this->Camera_->TriggerSelector.SetValue( TriggerSelector_AcquisitionStart );
-            this->Camera_->TriggerMode.SetValue( TriggerMode_On );
+            if(_selectAcquisitionStartTrigger())
+                this->Camera_->TriggerMode.SetValue( TriggerMode_On );
             
             GenApi::IEnumEntry *enumEntryFrameStart = Camera_->TriggerSelector.GetEntryByName("FrameStart");                    
             if(enumEntryFrameStart && GenApi::IsAvailable(enumEntryFrameStart))                     
@@ -787,6 +1576,7 @@ void Camera::setTrigMode(TrigMode mode)
             this->Camera_->AcquisitionFrameRateEnable.SetValue( false );
             this->Camera_->ExposureMode.SetValue( ExposureMode_Timed );
         }
+        m_trig_mode = mode;
     }
      catch (GenICam::GenericException &e)
     {
@@ -804,12 +1594,14 @@ void Camera::setTrigMode(TrigMode mode)
 void Camera::getTrigMode(TrigMode& mode)
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     int frameStart = TriggerMode_Off, acqStart = TriggerMode_Off, expMode;
     
     try
     {
-        this->Camera_->TriggerSelector.SetValue( TriggerSelector_AcquisitionStart );
-        acqStart =  this->Camera_->TriggerMode.GetValue();
+        if(_selectAcquisitionStartTrigger())
+            acqStart =  this->Camera_->TriggerMode.GetValue();
 
         GenApi::IEnumEntry *enumEntryFrameStart = Camera_->TriggerSelector.GetEntryByName("FrameStart");  
         if(enumEntryFrameStart && GenApi::IsAvailable(enumEntryFrameStart))            
@@ -843,7 +1635,7 @@ void Camera::setExpTime(double exp_time)
 {
     DEB_MEMBER_FUNCT();
     DEB_PARAM() << DEB_VAR1(exp_time);
-    
+    AutoMutex aDeviceLock(m_device_lock);
     
     TrigMode mode;
     getTrigMode(mode);
@@ -868,7 +1660,7 @@ void Camera::setExpTime(double exp_time)
             {
                 // More recent model like ACE and AVIATOR support direct programming of the exposure using
                 // the exposure time absolute.
-                Camera_->ExposureTimeAbs.SetValue(1E6 * exp_time);
+                m_exposure_time_node->SetValue(1E6 * exp_time);
             }
         }
         
@@ -883,8 +1675,8 @@ void Camera::setExpTime(double exp_time)
         {
             double periode = m_latency_time + m_exp_time;
             Camera_->AcquisitionFrameRateEnable.SetValue(true);
-            Camera_->AcquisitionFrameRateAbs.SetValue(1 / periode);
-            DEB_TRACE() << DEB_VAR1(Camera_->AcquisitionFrameRateAbs.GetValue());
+            m_frame_rate_node->SetValue(1 / periode);
+            DEB_TRACE() << DEB_VAR1(m_frame_rate_node->GetValue());
         }
 
     }
@@ -901,9 +1693,11 @@ void Camera::setExpTime(double exp_time)
 void Camera::getExpTime(double& exp_time)
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
-        double value = 1.0E-6 * static_cast<double>(Camera_->ExposureTimeAbs.GetValue());    
+        double value = 1.0E-6 * static_cast<double>(m_exposure_time_node->GetValue());
         exp_time = value;
     }
     catch (GenICam::GenericException &e)
@@ -940,6 +1734,8 @@ void Camera::getLatTime(double& lat_time)
 void Camera::getExposureTimeRange(double& min_expo, double& max_expo) const
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
 
     try
     {
@@ -972,8 +1768,8 @@ void Camera::getExposureTimeRange(double& min_expo, double& max_expo) const
         }
         else
         {
-            min_expo = Camera_->ExposureTimeAbs.GetMin()*1e-6;
-            max_expo = Camera_->ExposureTimeAbs.GetMax()*1e-6;
+            min_expo = m_exposure_time_node->GetMin()*1e-6;
+            max_expo = m_exposure_time_node->GetMax()*1e-6;
         }
     }
     catch (GenICam::GenericException &e)
@@ -992,10 +1788,12 @@ void Camera::getExposureTimeRange(double& min_expo, double& max_expo) const
 void Camera::getLatTimeRange(double& min_lat, double& max_lat) const
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         min_lat = 0;
-        double minAcqFrameRate = Camera_->AcquisitionFrameRateAbs.GetMin();
+        double minAcqFrameRate = m_frame_rate_node->GetMin();
         if (minAcqFrameRate > 0)
             max_lat = 1 / minAcqFrameRate;
         else
@@ -1035,7 +1833,7 @@ void Camera::getNbFrames(int& nb_frames)
 void Camera::getNbHwAcquiredFrames(int &nb_acq_frames)
 { 
     DEB_MEMBER_FUNCT();    
-    nb_acq_frames = m_image_number;
+    nb_acq_frames = int(_getNbAcquiredFrames());
 }
   
 //-----------------------------------------------------
@@ -1044,31 +1842,60 @@ void Camera::getNbHwAcquiredFrames(int &nb_acq_frames)
 void Camera::getStatus(Camera::Status& status)
 {
     DEB_MEMBER_FUNCT();
-    AutoMutex aLock(m_cond.mutex());
-    status = m_status;
+    status = _getStatus();
     DEB_RETURN() << DEB_VAR1(DEB_HEX(status));
 }
 
 //-----------------------------------------------------
-//
+// Called for each frame, no debug here, the changes are
+// recorded in the trace ring. The status is published
+// lock-free, m_cond is only taken on a real transition.
 //-----------------------------------------------------
 void Camera::_setStatus(Camera::Status status,bool force)
 {
-    DEB_MEMBER_FUNCT();
+    if(_getStatus() == status)
+        return;
     AutoMutex aLock(m_cond.mutex());
-    if(force || m_status != Camera::Fault)
-        m_status = status;
+    Camera::Status current = _getStatus();
+    if(current == status)
+        return;
+    if(force || current != Camera::Fault)
+    {
+        atomicStore(&m_status,status);
+        BASLER_TRACE(m_trace_ring,TraceStatus,_getNbAcquiredFrames(),status,
+                     Timestamp::now());
+        if(status == Camera::Fault)
+            m_notifier.post(NotifyFault);
+    }
     m_cond.broadcast();
 }
+
+//-----------------------------------------------------
+// Publishes m_image_number to the other threads, waitFrame
+// callers are only woken up when there are some: they count
+// themselves in before checking the counter.
+//-----------------------------------------------------
+void Camera::_publishImageNumber()
+{
+    // a full barrier: the waiters must be read after the store
+    atomicExchange(&m_nb_acquired_frames,m_image_number);
+    if(atomicLoad(&m_nb_frame_waiters))
+    {
+        AutoMutex aLock(m_frame_cond.mutex());
+        m_frame_cond.broadcast();
+    }
+}
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
 void Camera::getFrameRate(double& frame_rate) const
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
-        frame_rate = static_cast<double>(Camera_->ResultingFrameRateAbs.GetValue());        
+        frame_rate = static_cast<double>(m_resulting_frame_rate_node->GetValue());
     }
     catch (GenICam::GenericException &e)
     {
@@ -1093,6 +1920,8 @@ void Camera::checkRoi(const Roi& set_roi, Roi& hw_roi)
 {
     DEB_MEMBER_FUNCT();
     DEB_PARAM() << DEB_VAR1(set_roi);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         if (set_roi.isActive())
@@ -1120,6 +1949,8 @@ void Camera::setRoi(const Roi& ask_roi)
 {
     DEB_MEMBER_FUNCT();
     DEB_PARAM() << DEB_VAR1(ask_roi);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     Roi set_roi;
     checkRoi(ask_roi,set_roi);
     Roi r;    
@@ -1128,10 +1959,20 @@ void Camera::setRoi(const Roi& ask_roi)
         //- backup old roi, in order to rollback if error
         getRoi(r);
         if(r == set_roi) return;
-        
-        //- first reset the ROI
-        Camera_->OffsetX.SetValue(Camera_->OffsetX.GetMin());
-        Camera_->OffsetY.SetValue(Camera_->OffsetY.GetMin());
+
+        //- same size, only the offsets change
+        if(set_roi.isActive() && r.getSize() == set_roi.getSize())
+        {
+            _checkRoiOffsets(set_roi.getTopLeft().x,set_roi.getTopLeft().y,
+                             r.getSize().getWidth(),r.getSize().getHeight());
+            Camera_->OffsetX.SetValue(set_roi.getTopLeft().x);
+            Camera_->OffsetY.SetValue(set_roi.getTopLeft().y);
+            return;
+        }
+        
+        //- first reset the ROI
+        Camera_->OffsetX.SetValue(Camera_->OffsetX.GetMin());
+        Camera_->OffsetY.SetValue(Camera_->OffsetY.GetMin());
         Camera_->Width.SetValue(Camera_->Width.GetMax());
         Camera_->Height.SetValue(Camera_->Height.GetMax());
         
@@ -1175,6 +2016,8 @@ void Camera::setRoi(const Roi& ask_roi)
 void Camera::getRoi(Roi& hw_roi)
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         Roi  r( static_cast<int>(Camera_->OffsetX()),
@@ -1193,12 +2036,140 @@ void Camera::getRoi(Roi& hw_roi)
     DEB_RETURN() << DEB_VAR1(hw_roi);
 }
 
+//-----------------------------------------------------
+// Throws InvalidValue if the offsets aren't a multiple of the
+// camera increments or put a width x height roi out of the sensor.
+//-----------------------------------------------------
+void Camera::_checkRoiOffsets(int x,int y,int width,int height)
+{
+    DEB_MEMBER_FUNCT();
+    int inc_x = int(Camera_->OffsetX.GetInc());
+    int inc_y = int(Camera_->OffsetY.GetInc());
+    if(x < 0 || y < 0 || x % inc_x || y % inc_y ||
+       x + width > int(Camera_->WidthMax.GetValue()) ||
+       y + height > int(Camera_->HeightMax.GetValue()))
+      THROW_HW_ERROR(InvalidValue) << "Invalid offsets " << DEB_VAR2(x,y)
+				   << " for a " << width << "x" << height << " roi"
+				   << " (increments " << inc_x << "x" << inc_y << ")";
+}
+
+//-----------------------------------------------------
+// Only during an acquisition, outside one the Lima roi must be
+// changed with setRoi. The payload size doesn't change, so the
+// stream grabber is kept and the new offsets apply to the next
+// frames. The camera clock is latched after the write to find the
+// first frame exposed with them, _confirmRoiMoves records it when
+// the frame is retrieved.
+//-----------------------------------------------------
+void Camera::moveRoi(int x,int y)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(x,y);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    if(!m_thread_running)
+      THROW_HW_ERROR(Error) << "No acquisition running, use setRoi to change the roi";
+    try
+    {
+	if(!GenApi::IsWritable(Camera_->OffsetX) || !GenApi::IsWritable(Camera_->OffsetY))
+	  THROW_HW_ERROR(NotSupported) << "Roi offsets can't be changed now on this camera";
+
+	_checkRoiOffsets(x,y,int(Camera_->Width.GetValue()),int(Camera_->Height.GetValue()));
+
+	Camera_->OffsetX.SetValue(x);
+	Camera_->OffsetY.SetValue(y);
+	// replayed by a reconnection, which waits for the device lock
+	m_config.roi = Roi(Point(x,y),m_config.roi.getSize());
+
+	_RoiMove move;
+	move.tick = 0;
+	move.x = x;
+	move.y = y;
+	if(m_cam_tick_period > 0. && !_readCameraTick(move.tick))
+	  move.tick = 0;
+
+	AutoMutex aLock(m_roi_lock);
+	m_roi_moves.push_back(move);
+	m_roi_move_pending = true;
+    }
+    catch (GenICam::GenericException &e)
+    {
+        // Error handling
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+}
+
+void Camera::getRoiOffset(long frame_nb,int& x,int& y)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(frame_nb);
+    if(frame_nb < 0 || frame_nb >= _getNbAcquiredFrames())
+      THROW_HW_ERROR(InvalidValue) << "Frame " << frame_nb << " is not acquired";
+
+    AutoMutex aLock(m_roi_lock);
+    if(m_roi_offsets.empty() || frame_nb < m_roi_offsets.front().first_frame)
+      THROW_HW_ERROR(InvalidValue) << "Offsets of frame " << frame_nb << " are no longer known";
+    std::deque<_RoiOffset>::reverse_iterator i = m_roi_offsets.rbegin();
+    while(i->first_frame > frame_nb)
+      ++i;
+    x = i->x;
+    y = i->y;
+    DEB_RETURN() << DEB_VAR2(x,y);
+}
+
+void Camera::_resetRoiMoves()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_roi_lock);
+    m_roi_moves.clear();
+    m_roi_move_pending = false;
+    m_roi_offsets.clear();
+    try
+    {
+	_RoiOffset offset = {0,int(Camera_->OffsetX.GetValue()),
+			     int(Camera_->OffsetY.GetValue())};
+	m_roi_offsets.push_back(offset);
+    }
+    catch (GenICam::GenericException &e)
+    {
+        // Error handling
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+}
+
+//-----------------------------------------------------
+// Called by the acquisition thread for the current frame
+// while moves are pending. A move without camera tick
+// applies to the first frame retrieved after it.
+//-----------------------------------------------------
+void Camera::_confirmRoiMoves(const GrabResult& result)
+{
+    unsigned long long frame_tick = result.GetTimeStamp();
+    AutoMutex aLock(m_roi_lock);
+    while(!m_roi_moves.empty() &&
+	  (!m_roi_moves.front().tick || m_roi_moves.front().tick <= frame_tick))
+    {
+	const _RoiMove& move = m_roi_moves.front();
+	_RoiOffset offset = {m_image_number,move.x,move.y};
+	if(!m_roi_offsets.empty() && m_roi_offsets.back().first_frame == m_image_number)
+	  m_roi_offsets.back() = offset;
+	else
+	  m_roi_offsets.push_back(offset);
+	if(int(m_roi_offsets.size()) > MAX_ROI_OFFSETS)
+	  m_roi_offsets.pop_front();
+	m_roi_moves.pop_front();
+    }
+    m_roi_move_pending = !m_roi_moves.empty();
+}
+
 //-----------------------------------------------------
 //
 //-----------------------------------------------------
 void Camera::checkBin(Bin &aBin)
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         int x = aBin.getX();
@@ -1223,6 +2194,8 @@ void Camera::checkBin(Bin &aBin)
 void Camera::setBin(const Bin &aBin)
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     _freeStreamGrabber();
     try
     {
@@ -1243,6 +2216,8 @@ void Camera::setBin(const Bin &aBin)
 void Camera::getBin(Bin &aBin)
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
     	aBin = Bin(Camera_->BinningVertical.GetValue(), Camera_->BinningHorizontal.GetValue());
@@ -1261,10 +2236,11 @@ void Camera::getBin(Bin &aBin)
 bool Camera::isBinningAvailable() const
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
     bool isAvailable = false;
     try
     {
-      isAvailable = (GenApi::IsAvailable(Camera_->BinningVertical) &&
+      isAvailable = Camera_ && (GenApi::IsAvailable(Camera_->BinningVertical) &&
 		     GenApi::IsAvailable(Camera_->BinningHorizontal));
     }
     catch (GenICam::GenericException &e)
@@ -1278,10 +2254,11 @@ bool Camera::isBinningAvailable() const
 bool Camera::isRoiAvailable() const
 {
   DEB_MEMBER_FUNCT();
+  AutoMutex aDeviceLock(m_device_lock);
   bool isAvailable = false;
   try
     {
-      isAvailable = (GenApi::IsAvailable(Camera_->OffsetX) && GenApi::IsWritable(Camera_->OffsetX) &&
+      isAvailable = Camera_ && (GenApi::IsAvailable(Camera_->OffsetX) && GenApi::IsWritable(Camera_->OffsetX) &&
 		     GenApi::IsAvailable(Camera_->OffsetY) && GenApi::IsWritable(Camera_->OffsetY) &&
 		     GenApi::IsAvailable(Camera_->Width) && GenApi::IsWritable(Camera_->Width) &&
 		     GenApi::IsAvailable(Camera_->Height) && GenApi::IsWritable(Camera_->Height));
@@ -1300,6 +2277,8 @@ void Camera::setInterPacketDelay(int ipd)
 {
     DEB_MEMBER_FUNCT();
     DEB_PARAM() << DEB_VAR1(ipd);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         Camera_->GevSCPD.SetValue(ipd);
@@ -1317,6 +2296,8 @@ void Camera::setInterPacketDelay(int ipd)
 void Camera::getTemperature(double& temperature)
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         // If the parameter TemperatureAbs is available for this camera
@@ -1336,6 +2317,8 @@ void Camera::setAutoGain(bool auto_gain)
 {
     DEB_MEMBER_FUNCT();
     DEB_PARAM() << DEB_VAR1(auto_gain);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         if (GenApi::IsAvailable(Camera_->GainAuto) && GenApi::IsAvailable(Camera_->GainSelector))
@@ -1363,6 +2346,8 @@ void Camera::setAutoGain(bool auto_gain)
 void Camera::getAutoGain(bool& auto_gain) const
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         if (GenApi::IsAvailable(Camera_->GainAuto))
@@ -1391,6 +2376,8 @@ void Camera::setGain(double gain)
 {
     DEB_MEMBER_FUNCT();
     DEB_PARAM() << DEB_VAR1(gain);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         // you want to set the gain, remove autogain
@@ -1420,6 +2407,14 @@ void Camera::setGain(double gain)
             }
             Camera_->GainRaw.SetValue(gain_raw);
             DEB_TRACE() << "gain_raw = " << gain_raw;
+        }
+        else if (m_gain_node.IsValid() && GenApi::IsWritable(m_gain_node))
+        {
+            // USB3 Vision cameras only have the gain in dB
+            double low_limit = m_gain_node->GetMin();
+            double hight_limit = m_gain_node->GetMax();
+            m_gain_node->SetValue(low_limit + (hight_limit - low_limit) *
+				  max(0.,min(1.,gain)));
         }
 		else
 		{
@@ -1439,6 +2434,8 @@ void Camera::setGain(double gain)
 void Camera::getGain(double& gain) const
 {
     DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         if (GenApi::IsAvailable(Camera_->GainRaw))
@@ -1449,6 +2446,12 @@ void Camera::getGain(double& gain) const
 
             gain = double(gain_raw - low_limit) / (hight_limit - low_limit);
         }
+        else if (m_gain_node.IsValid() && GenApi::IsReadable(m_gain_node))
+        {
+            double low_limit = m_gain_node->GetMin();
+            double hight_limit = m_gain_node->GetMax();
+            gain = (m_gain_node->GetValue() - low_limit) / (hight_limit - low_limit);
+        }
         else
         {
             gain = 0.;
@@ -1469,6 +2472,8 @@ void Camera::setFrameTransmissionDelay(int ftd)
 {
     DEB_MEMBER_FUNCT();
     DEB_PARAM() << DEB_VAR1(ftd);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
     try
     {
         Camera_->GevSCFTD.SetValue(ftd);
@@ -1480,6 +2485,198 @@ void Camera::setFrameTransmissionDelay(int ftd)
     }
 }
 
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::setLiveGrabStrategy(LiveGrabStrategy strategy)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(strategy);
+    m_live_grab_strategy = strategy;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getLiveGrabStrategy(LiveGrabStrategy& strategy) const
+{
+    DEB_MEMBER_FUNCT();
+    strategy = m_live_grab_strategy;
+    DEB_RETURN() << DEB_VAR1(strategy);
+}
+
+//-----------------------------------------------------
+// Raw frames are all needed by the accumulation, the run statistics
+// and the beam monitor, they are not skipped. Color frames are not
+// grabbed in the raw buffers.
+//-----------------------------------------------------
+bool Camera::_isLatestImageOnly() const
+{
+    return !m_nb_frames && m_live_grab_strategy == LatestImageOnly && !m_color_flag &&
+      m_raw_stream_file.empty() && m_accumulator.getNbFrames() <= 1 &&
+      !m_accumulator.getRunStatistics() && !m_beam_monitor_active;
+}
+
+//-----------------------------------------------------
+// Number of frames dropped by the LatestImageOnly strategy
+// since the last prepareAcq
+//-----------------------------------------------------
+void Camera::getNbSkippedFrames(long& nb_skipped_frames) const
+{
+    DEB_MEMBER_FUNCT();
+    nb_skipped_frames = long(atomicLoad(&m_skipped_frames));
+    DEB_RETURN() << DEB_VAR1(nb_skipped_frames);
+}
+
+//-----------------------------------------------------
+// With internal trigger, the acquisition goes in Fault after
+// nb_frames missed frame periods, 0 disables the watchdog and
+// the fixed timeout (setTimeout) is used.
+//-----------------------------------------------------
+void Camera::setWatchdogMissedFrames(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if(nb_frames < 0)
+      THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_frames);
+    m_watchdog_missed_frames = nb_frames;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getWatchdogMissedFrames(int& nb_frames) const
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_watchdog_missed_frames;
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+// With external trigger, maximum time (in second) allowed between
+// two triggers, 0 means the fixed timeout (setTimeout) is used.
+//-----------------------------------------------------
+void Camera::setExtTrigTimeout(double timeout)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(timeout);
+    if(timeout < 0.)
+      THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(timeout);
+    m_ext_trig_timeout = timeout;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getExtTrigTimeout(double& timeout) const
+{
+    DEB_MEMBER_FUNCT();
+    timeout = m_ext_trig_timeout;
+    DEB_RETURN() << DEB_VAR1(timeout);
+}
+
+//-----------------------------------------------------
+// When no frame arrives during period (in second), the acquisition
+// thread reads a register from the device to check it's still there.
+// 0 disables the heartbeat.
+//-----------------------------------------------------
+void Camera::setHeartbeatPeriod(double period)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(period);
+    if(period < 0.)
+      THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(period);
+    m_heartbeat_period = period;
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::getHeartbeatPeriod(double& period) const
+{
+    DEB_MEMBER_FUNCT();
+    period = m_heartbeat_period;
+    DEB_RETURN() << DEB_VAR1(period);
+}
+
+//-----------------------------------------------------
+// Watchdog timeout (in ms) in use for the current acquisition
+//-----------------------------------------------------
+void Camera::getWatchdogTimeout(int& timeout) const
+{
+    DEB_MEMBER_FUNCT();
+    timeout = m_watchdog_timeout;
+    DEB_RETURN() << DEB_VAR1(timeout);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_computeWatchdogTimeout()
+{
+    DEB_MEMBER_FUNCT();
+    double timeout = m_timeout;
+    if(m_trig_mode == IntTrig)
+    {
+	if(m_watchdog_missed_frames > 0)
+	{
+	    double period = m_exp_time + m_latency_time;
+	    if(m_resulting_frame_rate_node.IsValid() &&
+	       GenApi::IsReadable(m_resulting_frame_rate_node))
+	    {
+		double frame_rate = m_resulting_frame_rate_node->GetValue();
+		if(frame_rate > 0. && 1. / frame_rate > period)
+		  period = 1. / frame_rate;
+	    }
+	    // first frame also needs its exposure
+	    timeout = (m_watchdog_missed_frames * period + m_exp_time) * 1e3 +
+	      MIN_WATCHDOG_TIME_OUT;
+	}
+    }
+    else if(m_ext_trig_timeout > 0.)
+      timeout = (m_ext_trig_timeout + m_exp_time) * 1e3 + MIN_WATCHDOG_TIME_OUT;
+
+    m_watchdog_timeout = timeout < m_timeout ? int(timeout) : m_timeout;
+    DEB_TRACE() << DEB_VAR1(m_watchdog_timeout);
+}
+
+//-----------------------------------------------------
+// Called under m_device_lock, Camera_ is then either NULL or
+// configured. There is no camera before open() with lazy_open, nor
+// after a failed reconnection, it then stays in Fault until
+// reconnect() succeeds.
+//-----------------------------------------------------
+void Camera::_checkCamera() const
+{
+    DEB_MEMBER_FUNCT();
+    if(Camera_) return;
+    if(m_opened)
+      THROW_HW_ERROR(Error) << "Camera " << m_camera_id << " lost, reconnect() needed";
+    else
+      THROW_HW_ERROR(Error) << "Camera " << m_camera_id << " not opened";
+}
+
+//-----------------------------------------------------
+// Force a register read on the device, bypassing the node cache.
+// Width is mandatory in the SFNC, so every transport has it.
+//-----------------------------------------------------
+bool Camera::_checkDevice()
+{
+    DEB_MEMBER_FUNCT();
+    if(m_device_removed) return false;
+    try
+    {
+	m_heartbeat_node->GetValue(false,true);
+	return true;
+    }
+    catch (GenICam::GenericException &e)
+    {
+	DEB_ERROR() << "Heartbeat failed, device lost " << e.GetDescription();
+	m_device_removed = true;
+	return false;
+    }
+}
+
 //---------------------------
 //- Camera::reset()
 //---------------------------
@@ -1510,8 +2707,9 @@ void Camera::isColor(bool& color_flag) const
 void Camera::getStatisticsTotalBufferCount(long& count)
 {
 	DEB_MEMBER_FUNCT();
+	AutoMutex aDeviceLock(m_device_lock);
 	if(StreamGrabber_ != NULL)
-		count = StreamGrabber_->Statistic_Total_Buffer_Count.GetValue();
+		count = _get_stream_counter(StreamGrabber_->GetNodeMap(),"Statistic_Total_Buffer_Count");
 	else
 		count = -1;//Because Not valid when acquisition is stopped
 }
@@ -1523,9 +2721,2557 @@ void Camera::getStatisticsTotalBufferCount(long& count)
 void Camera::getStatisticsFailedBufferCount(long& count)
 {
 	DEB_MEMBER_FUNCT();
+	AutoMutex aDeviceLock(m_device_lock);
 	if(StreamGrabber_ != NULL)
-		count = StreamGrabber_->Statistic_Failed_Buffer_Count.GetValue();
+		count = _get_stream_counter(StreamGrabber_->GetNodeMap(),"Statistic_Failed_Buffer_Count");
 	else
 		count = -1;//Because Not valid when acquisition is stopped
 }
 //---------------------------    
+
+//---------------------------
+// Stream statistics are sampled by the acquisition thread at most once per
+// period and at the end of each acquisition, so they are still available
+// once the stream grabber is released.
+//---------------------------
+void Camera::getStreamStatistics(StreamStatistics& stats)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_stats_lock);
+    stats = m_stream_stats;
+    stats.socket_buffer_size = m_effective_stream_params[0];
+    stats.resend_timeout = m_effective_stream_params[1];
+    stats.resend_request_threshold = m_effective_stream_params[2];
+    stats.receive_window_size = m_effective_stream_params[3];
+    stats.packet_timeout = m_effective_stream_params[4];
+    stats.frame_retention = m_effective_stream_params[5];
+    stats.max_transfer_size = m_effective_stream_params[6];
+    stats.nb_max_queued_urbs = m_effective_stream_params[7];
+}
+
+void Camera::setStreamStatisticsPeriod(double period)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(period);
+    if(period < 0.)
+      THROW_HW_ERROR(InvalidValue) << "Period must be positive";
+    m_stats_period = period;
+}
+
+void Camera::getStreamStatisticsPeriod(double& period) const
+{
+    DEB_MEMBER_FUNCT();
+    period = m_stats_period;
+    DEB_RETURN() << DEB_VAR1(period);
+}
+
+void Camera::_resetStreamStatistics()
+{
+    AutoMutex aLock(m_stats_lock);
+    m_stream_stats.total_buffer_count = 0;
+    m_stream_stats.failed_buffer_count = 0;
+    m_stream_stats.buffer_underrun_count = 0;
+    m_stream_stats.total_packet_count = 0;
+    m_stream_stats.lost_packet_count = 0;
+    m_stream_stats.resent_packet_count = 0;
+    m_stream_stats.resend_request_count = 0;
+    m_stream_stats.resynchronization_count = 0;
+    m_stream_stats.last_error_code = 0;
+    m_stream_stats.bandwidth = 0.;
+    m_stats_start = Timestamp::now();
+    m_stream_stats.timestamp = m_stats_sample_time = m_stats_start;
+}
+
+void Camera::_sampleStreamStatistics()
+{
+    DEB_MEMBER_FUNCT();
+    if(!StreamGrabber_) return;
+
+    try
+    {
+	GenApi::INodeMap* nodemap = StreamGrabber_->GetNodeMap();
+	StreamStatistics stats;
+	stats.total_buffer_count = _get_stream_counter(nodemap,"Statistic_Total_Buffer_Count");
+	stats.failed_buffer_count = _get_stream_counter(nodemap,"Statistic_Failed_Buffer_Count");
+	stats.buffer_underrun_count = _get_stream_counter(nodemap,"Statistic_Buffer_Underrun_Count");
+	stats.total_packet_count = _get_stream_counter(nodemap,"Statistic_Total_Packet_Count");
+	stats.lost_packet_count = _get_stream_counter(nodemap,"Statistic_Failed_Packet_Count");
+	stats.resent_packet_count = _get_stream_counter(nodemap,"Statistic_Resend_Packet_Count");
+	stats.resend_request_count = _get_stream_counter(nodemap,"Statistic_Resend_Request_Count");
+	stats.resynchronization_count = _get_stream_counter(nodemap,"Statistic_Resynchronization_Count");
+	stats.timestamp = m_stats_sample_time = Timestamp::now();
+
+	AutoMutex aLock(m_stats_lock);
+	stats.last_error_code = m_stream_stats.last_error_code;
+	double elapsed = stats.timestamp - double(m_stats_start);
+	long nb_buffers = stats.total_buffer_count - stats.failed_buffer_count;
+	stats.bandwidth = elapsed > 0. && nb_buffers > 0 ?
+	  double(nb_buffers) * ImageSize_ / elapsed : 0.;
+	m_stream_stats = stats;
+    }
+    catch (GenICam::GenericException &e)
+    {
+        DEB_WARNING() << e.GetDescription();
+    }
+}
+
+void Camera::_setLastErrorCode(long error_code)
+{
+    AutoMutex aLock(m_stats_lock);
+    m_stream_stats.last_error_code = error_code;
+}
+
+//---------------------------
+// The camera clock is latched against the host clock at each start, so
+// camera timestamps of the grab results can be compared to host times.
+//---------------------------
+void Camera::_latchCameraClock()
+{
+    DEB_MEMBER_FUNCT();
+    m_cam_tick_period = 0.;
+    if(GenApi::IsAvailable(Camera_->GevTimestampControlLatch) &&
+       GenApi::IsAvailable(Camera_->GevTimestampTickFrequency) &&
+       GenApi::IsAvailable(Camera_->GevTimestampValue))
+    {
+	Camera_->GevTimestampControlLatch.Execute();
+	double host_time = Timestamp::now();
+	double tick_freq = double(Camera_->GevTimestampTickFrequency.GetValue());
+	double cam_time = double(Camera_->GevTimestampValue.GetValue()) / tick_freq;
+	m_cam_tick_period = 1. / tick_freq;
+	m_cam_time_offset = host_time - cam_time;
+    }
+    else
+    {
+	// USB3 Vision cameras count in ns
+	GenApi::INodeMap& nodemap = Camera_->GetNodeMap();
+	GenApi::CCommandPtr latch = nodemap.GetNode("TimestampLatch");
+	GenApi::CIntegerPtr value = nodemap.GetNode("TimestampLatchValue");
+	if(latch.IsValid() && value.IsValid() &&
+	   GenApi::IsWritable(latch) && GenApi::IsReadable(value))
+	{
+	    latch->Execute();
+	    double host_time = Timestamp::now();
+	    m_cam_tick_period = 1e-9;
+	    m_cam_time_offset = host_time - 1e-9 * double(value->GetValue());
+	}
+    }
+    DEB_TRACE() << DEB_VAR2(m_cam_tick_period,m_cam_time_offset);
+}
+
+//---------------------------
+// Camera clock ticks, latched now
+//---------------------------
+bool Camera::_readCameraTick(unsigned long long& tick)
+{
+    if(GenApi::IsAvailable(Camera_->GevTimestampControlLatch) &&
+       GenApi::IsAvailable(Camera_->GevTimestampValue))
+    {
+	Camera_->GevTimestampControlLatch.Execute();
+	tick = (unsigned long long)Camera_->GevTimestampValue.GetValue();
+	return true;
+    }
+    GenApi::INodeMap& nodemap = Camera_->GetNodeMap();
+    GenApi::CCommandPtr latch = nodemap.GetNode("TimestampLatch");
+    GenApi::CIntegerPtr value = nodemap.GetNode("TimestampLatchValue");
+    if(latch.IsValid() && value.IsValid() &&
+       GenApi::IsWritable(latch) && GenApi::IsReadable(value))
+    {
+	latch->Execute();
+	tick = (unsigned long long)value->GetValue();
+	return true;
+    }
+    return false;
+}
+
+void Camera::_recordLatency(const GrabResult& result,double retrieve_time,
+			    double queue_time,double delivered_time)
+{
+    if(m_cam_tick_period > 0.)
+    {
+	double cam_time = double(result.GetTimeStamp()) * m_cam_tick_period + m_cam_time_offset;
+	m_latency[Transfer].record(retrieve_time - cam_time);
+	m_latency[Total].record(delivered_time - cam_time);
+    }
+    m_latency[Requeue].record(queue_time - retrieve_time);
+    m_latency[Delivery].record(delivered_time - queue_time);
+}
+
+//---------------------------
+// Histograms are reset by prepareAcq and updated without lock by the
+// acquisition thread, a query during the acquisition is a best-effort
+// snapshot.
+//---------------------------
+void Camera::getLatencyStatistics(LatencyStage stage,LatencyStatistics& stats) const
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(stage);
+    const LatencyHistogram& histogram = getLatencyHistogram(stage);
+    stats.count = histogram.getCount();
+    stats.min = histogram.getMin();
+    stats.max = histogram.getMax();
+    stats.mean = histogram.getMean();
+    stats.p50 = histogram.getPercentile(50.);
+    stats.p90 = histogram.getPercentile(90.);
+    stats.p99 = histogram.getPercentile(99.);
+    stats.p999 = histogram.getPercentile(99.9);
+}
+
+const LatencyHistogram& Camera::getLatencyHistogram(LatencyStage stage) const
+{
+    DEB_MEMBER_FUNCT();
+    if(stage < 0 || stage >= NB_LATENCY_STAGE)
+      THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(stage);
+    return m_latency[stage];
+}
+
+//-----------------------------------------------------
+// When enabled, a lost camera is re-opened by the acquisition
+// thread from its cached identity and the last committed
+// configuration is reapplied.
+//-----------------------------------------------------
+void Camera::setAutoReconnect(bool flag)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(flag);
+    m_auto_reconnect = flag;
+}
+
+void Camera::getAutoReconnect(bool& flag) const
+{
+    DEB_MEMBER_FUNCT();
+    flag = m_auto_reconnect;
+    DEB_RETURN() << DEB_VAR1(flag);
+}
+
+//-----------------------------------------------------
+// After an automatic reconnection, restart the running acquisition
+// where it stopped, with the frame numbering intact.
+//-----------------------------------------------------
+void Camera::setAutoResume(bool flag)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(flag);
+    m_auto_resume = flag;
+}
+
+void Camera::getAutoResume(bool& flag) const
+{
+    DEB_MEMBER_FUNCT();
+    flag = m_auto_resume;
+    DEB_RETURN() << DEB_VAR1(flag);
+}
+
+//-----------------------------------------------------
+// Maximum time (in second) spent waiting for the camera to come back
+//-----------------------------------------------------
+void Camera::setReconnectTimeout(double timeout)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(timeout);
+    if(timeout < 0.)
+      THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(timeout);
+    m_reconnect_timeout = timeout;
+}
+
+void Camera::getReconnectTimeout(double& timeout) const
+{
+    DEB_MEMBER_FUNCT();
+    timeout = m_reconnect_timeout;
+    DEB_RETURN() << DEB_VAR1(timeout);
+}
+
+//-----------------------------------------------------
+// Manual reconnection, i.e: after a Fault, without destroying
+// the Camera object
+//-----------------------------------------------------
+void Camera::reconnect()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_cond.mutex());
+    if(m_thread_running)
+      THROW_HW_ERROR(Error) << "Can't reconnect while acquisition is running";
+    aLock.unlock();
+
+    _reconnect(false);
+    _setStatus(Camera::Ready,true);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_registerRemovalCallback()
+{
+    DEB_MEMBER_FUNCT();
+    m_device_removed = false;
+    m_removal_cb_handle = RegisterRemovalCallback(Camera_->GetDevice(),*this,
+						  &Camera::_removalCallback);
+}
+
+//-----------------------------------------------------
+// Called by Pylon when the device is removed (i.e: reboot,
+// cable unplugged). Wake up the acquisition thread.
+//-----------------------------------------------------
+void Camera::_removalCallback(IPylonDevice*)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_ERROR() << "Camera " << m_camera_id << " removed";
+    m_device_removed = true;
+    WaitObject_.Signal();
+}
+
+//-----------------------------------------------------
+// Keep the configuration in use, done at each start
+//-----------------------------------------------------
+void Camera::_saveConfig()
+{
+    DEB_MEMBER_FUNCT();
+    try
+    {
+	m_config.pixel_format = Camera_->PixelFormat.GetIntValue();
+	getRoi(m_config.roi);
+	m_config.bin_x = m_config.bin_y = 1;
+	if(isBinningAvailable())
+	{
+	    m_config.bin_x = int(Camera_->BinningHorizontal.GetValue());
+	    m_config.bin_y = int(Camera_->BinningVertical.GetValue());
+	}
+	m_config.packet_size = GenApi::IsReadable(Camera_->GevSCPSPacketSize) ?
+	  int(Camera_->GevSCPSPacketSize.GetValue()) : -1;
+	m_config.inter_packet_delay = GenApi::IsReadable(Camera_->GevSCPD) ?
+	  int(Camera_->GevSCPD.GetValue()) : -1;
+	m_config.frame_transmission_delay = GenApi::IsReadable(Camera_->GevSCFTD) ?
+	  int(Camera_->GevSCFTD.GetValue()) : -1;
+	m_config.gain_raw = GenApi::IsReadable(Camera_->GainRaw) ?
+	  int(Camera_->GainRaw.GetValue()) : -1;
+	m_config.gain = m_gain_node.IsValid() && GenApi::IsReadable(m_gain_node) ?
+	  m_gain_node->GetValue() : -1.;
+	m_config.auto_gain = GenApi::IsReadable(Camera_->GainAuto) &&
+	  Camera_->GainAuto.GetValue() != GainAuto_Off;
+	m_config.auto_exposure = GenApi::IsReadable(Camera_->ExposureAuto) &&
+	  Camera_->ExposureAuto.GetValue() != ExposureAuto_Off;
+	m_config.valid = true;
+    }
+    catch (GenICam::GenericException &e)
+    {
+	DEB_WARNING() << "Can't save configuration: " << e.GetDescription();
+    }
+}
+
+//-----------------------------------------------------
+// Reapply the last committed configuration in one go
+//-----------------------------------------------------
+void Camera::_applyConfig()
+{
+    DEB_MEMBER_FUNCT();
+    if(!m_config.valid) return;
+
+    try
+    {
+	Camera_->PixelFormat.SetIntValue(m_config.pixel_format);
+	if(isBinningAvailable())
+	{
+	    Camera_->BinningHorizontal.SetValue(m_config.bin_x);
+	    Camera_->BinningVertical.SetValue(m_config.bin_y);
+	}
+	if(isRoiAvailable())
+	{
+	    Camera_->OffsetX.SetValue(Camera_->OffsetX.GetMin());
+	    Camera_->OffsetY.SetValue(Camera_->OffsetY.GetMin());
+	    Camera_->Width.SetValue(m_config.roi.getSize().getWidth());
+	    Camera_->Height.SetValue(m_config.roi.getSize().getHeight());
+	    Camera_->OffsetX.SetValue(m_config.roi.getTopLeft().x);
+	    Camera_->OffsetY.SetValue(m_config.roi.getTopLeft().y);
+	}
+	_selectAcquisitionStartTrigger();
+	Camera_->AcquisitionMode.SetValue(AcquisitionMode_Continuous);
+	if(m_config.packet_size > 0)
+	  Camera_->GevSCPSPacketSize.SetValue(m_config.packet_size);
+	if(m_config.inter_packet_delay >= 0)
+	  Camera_->GevSCPD.SetValue(m_config.inter_packet_delay);
+	if(m_config.frame_transmission_delay >= 0)
+	  Camera_->GevSCFTD.SetValue(m_config.frame_transmission_delay);
+	if(GenApi::IsWritable(Camera_->GainAuto))
+	  Camera_->GainAuto.SetValue(m_config.auto_gain ? GainAuto_Continuous : GainAuto_Off);
+	if(!m_config.auto_gain && m_config.gain_raw >= 0)
+	  Camera_->GainRaw.SetValue(m_config.gain_raw);
+	else if(!m_config.auto_gain && m_config.gain >= 0. &&
+		m_gain_node.IsValid() && GenApi::IsWritable(m_gain_node))
+	  m_gain_node->SetValue(m_config.gain);
+	if(GenApi::IsWritable(Camera_->ExposureAuto))
+	  Camera_->ExposureAuto.SetValue(m_config.auto_exposure ?
+					 ExposureAuto_Continuous : ExposureAuto_Off);
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+    setTrigMode(m_trig_mode);
+    setExpTime(m_exp_time);
+}
+
+//-----------------------------------------------------
+// Release the stream grabber and the camera, the device may
+// already be gone so errors are only reported.
+//-----------------------------------------------------
+void Camera::_releaseDevice()
+{
+    DEB_MEMBER_FUNCT();
+    if(StreamGrabber_)
+    {
+	try
+	{
+	    _freeStreamGrabber();
+	}
+	catch (GenICam::GenericException &e)
+	{
+	    DEB_WARNING() << e.GetDescription();
+	    StreamGrabber_ = NULL;
+	}
+    }
+    if(Camera_)
+    {
+	try
+	{
+	    Camera_->GetDevice()->DeregisterRemovalCallback(m_removal_cb_handle);
+	    Camera_->Close();
+	}
+	catch (GenICam::GenericException &e)
+	{
+	    DEB_WARNING() << e.GetDescription();
+	}
+	delete Camera_;
+	Camera_ = NULL;
+    }
+}
+
+//-----------------------------------------------------
+// Re-open the same device from its cached identity, without name
+// resolution nor pixel format probing, and reapply the configuration.
+// If resume, the Lima buffers are registered again and the acquisition
+// restarted at the current image number. The control calls wait
+// for the new device under m_device_lock.
+//-----------------------------------------------------
+void Camera::_reconnect(bool resume)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(resume);
+    AutoMutex aDeviceLock(m_device_lock);
+
+    Timestamp start = Timestamp::now();
+    _releaseDevice();
+
+    CTlFactory& TlFactory = CTlFactory::GetInstance();
+    while(!Camera_)
+    {
+	IPylonDevice* device = NULL;
+	try
+	{
+	    device = TlFactory.CreateDevice(m_device_info);
+	    Camera_ = new Camera_t(device);
+	    Camera_->Open();
+	}
+	catch (GenICam::GenericException &e)
+	{
+	    DEB_TRACE() << "Camera not back yet: " << e.GetDescription();
+	    // the camera object owns the device once created
+	    if(Camera_)
+	      delete Camera_;
+	    else if(device)
+	      TlFactory.DestroyDevice(device);
+	    Camera_ = NULL;
+	    if(double(Timestamp::now() - start) > m_reconnect_timeout)
+	      THROW_HW_ERROR(Error) << "Unable to reconnect the camera: "
+				    << e.GetDescription();
+	    WaitObject::Sleep(RECONNECT_RETRY_DELAY);
+	}
+    }
+    _registerRemovalCallback();
+    _resolveFeatures();
+    _applyConfig();
+
+    try
+    {
+	ImageSize_ = (size_t)(Camera_->PayloadSize.GetValue());
+	if(m_color_flag)
+	  _initColorStreamGrabber();
+	else if(resume)
+	{
+	    int nb_buffers;
+	    m_buffer_ctrl_obj.getBuffer().getNbBuffers(nb_buffers);
+	    int nb_queued = nb_buffers;
+	    if(m_nb_frames && m_nb_frames - m_image_number < nb_buffers)
+	      nb_queued = m_nb_frames - m_image_number;
+	    _initStreamGrabber(m_image_number % nb_buffers,nb_queued);
+	}
+	if(resume)
+	{
+	    _latchCameraClock();
+	    Camera_->AcquisitionStart.Execute();
+	}
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+    DEB_TRACE() << "Camera reconnected in " << double(Timestamp::now() - start) << " s";
+}
+
+//-----------------------------------------------------
+// Called by the acquisition thread when the device is lost,
+// return true if the acquisition continues.
+//-----------------------------------------------------
+bool Camera::_recoverDevice(WaitObjects& waitset)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_ERROR() << "Camera " << m_camera_id << " lost";
+    if(!m_auto_reconnect) return false;
+    if(m_raw_writer.isOpen())
+    {
+	// written buffers belong to the lost stream grabber
+	DEB_ERROR() << "Raw streaming can't be resumed";
+	return false;
+    }
+
+    try
+    {
+	_reconnect(m_auto_resume);
+    }
+    catch (Exception &e)
+    {
+	DEB_ERROR() << e.getErrMsg();
+	return false;
+    }
+    if(!m_auto_resume) return false;
+
+    waitset.RemoveAll();
+    waitset.Add(WaitObject_);
+    waitset.Add(StreamGrabber_->GetWaitObject());
+    return true;
+}
+
+//-----------------------------------------------------
+// Save the current camera configuration in the user set
+// user_set (1..3) of the camera
+//-----------------------------------------------------
+void Camera::saveUserSet(int user_set)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(user_set);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    _selectUserSet(user_set,true);
+    try
+    {
+	Camera_->UserSetSave.Execute();
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+}
+
+//-----------------------------------------------------
+// Load the whole camera configuration from user set user_set
+// (0 is the factory default set, 1..3 the user sets).
+// When the image type, ROI or binning change, Lima is told through
+// the max image size callback and resets its ROI and binning.
+//-----------------------------------------------------
+void Camera::loadUserSet(int user_set)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(user_set);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    _checkNotRunning();
+    _selectUserSet(user_set,false);
+    _saveConfig();
+    _Config prev_config = m_config;
+    if(m_color_flag) _checkNoPinnedFrame();
+    try
+    {
+	_freeStreamGrabber();
+	Camera_->UserSetLoad.Execute();
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+    _syncConfig(prev_config);
+}
+
+//-----------------------------------------------------
+// User set loaded by the camera at power up, also used
+// when the camera reboots.
+//-----------------------------------------------------
+void Camera::setDefaultUserSet(int user_set)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(user_set);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    try
+    {
+	char name[16];
+	snprintf(name,sizeof(name),user_set ? "UserSet%d" : "Default",user_set);
+	GenApi::IEnumEntry *anEntry = Camera_->UserSetDefaultSelector.GetEntryByName(name);
+	if(!anEntry || !GenApi::IsAvailable(anEntry))
+	  THROW_HW_ERROR(InvalidValue) << "User set not available: " << DEB_VAR1(user_set);
+	Camera_->UserSetDefaultSelector.SetIntValue(anEntry->GetValue());
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+}
+
+//-----------------------------------------------------
+// Save all the camera features in a Pylon feature file (host side)
+//-----------------------------------------------------
+void Camera::saveFeatureFile(const std::string& filename)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(filename);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    try
+    {
+	CFeaturePersistence::Save(filename.c_str(),&Camera_->GetNodeMap());
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+}
+
+//-----------------------------------------------------
+// Load all the camera features from a Pylon feature file
+//-----------------------------------------------------
+void Camera::loadFeatureFile(const std::string& filename)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(filename);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    _checkNotRunning();
+    _saveConfig();
+    _Config prev_config = m_config;
+    if(m_color_flag) _checkNoPinnedFrame();
+    try
+    {
+	_freeStreamGrabber();
+	CFeaturePersistence::Load(filename.c_str(),&Camera_->GetNodeMap(),true);
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+    _syncConfig(prev_config);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_checkNotRunning()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_cond.mutex());
+    if(m_thread_running || _getStatus() != Camera::Ready)
+      THROW_HW_ERROR(Error) << "Not allowed while acquisition is running";
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_selectUserSet(int user_set,bool writable)
+{
+    DEB_MEMBER_FUNCT();
+    if(user_set < 0 || (writable && !user_set))
+      THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(user_set);
+    try
+    {
+	char name[16];
+	snprintf(name,sizeof(name),user_set ? "UserSet%d" : "Default",user_set);
+	GenApi::IEnumEntry *anEntry = Camera_->UserSetSelector.GetEntryByName(name);
+	if(!anEntry || !GenApi::IsAvailable(anEntry))
+	  THROW_HW_ERROR(InvalidValue) << "User set not available: " << DEB_VAR1(user_set);
+	Camera_->UserSetSelector.SetIntValue(anEntry->GetValue());
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+}
+
+//-----------------------------------------------------
+// Re-read the state kept by this object after the camera
+// configuration was changed behind its back, prev_config is
+// the configuration before the change.
+// The Lima control objects are chosen from the color flag when
+// the Interface is created, afterwards a color camera stays in
+// video mode (mono formats are video modes too) and a monochrome
+// pixel format can't be switched to a color one.
+//-----------------------------------------------------
+void Camera::_syncConfig(const _Config& prev_config)
+{
+    DEB_MEMBER_FUNCT();
+    getTrigMode(m_trig_mode);
+    try
+    {
+	GenApi::CEnumerationPtr pixel_format = Camera_->GetNodeMap().GetNode("PixelFormat");
+	std::string format = pixel_format->GetCurrentEntry()->GetSymbolic().c_str();
+	bool color_flag = !format.compare(0,5,"Bayer") || !format.compare(0,3,"RGB") ||
+	  !format.compare(0,3,"BGR") || !format.compare(0,3,"YUV");
+	if(color_flag != m_color_flag && (!m_interface_created || color_flag))
+	{
+	    if(m_interface_created)
+	      THROW_HW_ERROR(Error) << "Pixel format " << format
+				    << " needs the video mode, the camera must be re-created";
+	    DEB_TRACE() << "Switch to " << (color_flag ? "color" : "monochrome") << " mode";
+	    _checkNoPinnedFrame();
+	    _freeStreamGrabber();
+	    _freeColorBuffers();
+	    m_color_flag = color_flag;
+	}
+
+	ImageSize_ = (size_t)(Camera_->PayloadSize.GetValue());
+	m_exp_time = 1e-6 * m_exposure_time_node->GetValue();
+	m_latency_time = 0.;
+	if(Camera_->AcquisitionFrameRateEnable.GetValue())
+	{
+	    double period = 1. / m_frame_rate_node->GetValue();
+	    if(period > m_exp_time)
+	      m_latency_time = period - m_exp_time;
+	}
+	if(m_color_flag)
+	{
+	    // payload size may have changed, color buffers are reallocated
+	    _checkNoPinnedFrame();
+	    _freeStreamGrabber();
+	    _freeColorBuffers();
+	    _initColorStreamGrabber(true);
+	}
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+    _saveConfig();
+    DEB_TRACE() << DEB_VAR4(m_trig_mode,m_exp_time,m_latency_time,ImageSize_);
+
+    // WidthMax and HeightMax are given for the current binning
+    Size detector_size;
+    try
+    {
+	detector_size = Size(int(Camera_->WidthMax()) * m_config.bin_x,
+			     int(Camera_->HeightMax()) * m_config.bin_y);
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+    if(detector_size != m_detector_size || m_config.pixel_format != prev_config.pixel_format ||
+       m_config.roi != prev_config.roi || m_config.bin_x != prev_config.bin_x ||
+       m_config.bin_y != prev_config.bin_y)
+    {
+	m_detector_size = detector_size;
+	ImageType type;
+	getImageType(type);
+	DEB_TRACE() << "Geometry changed " << DEB_VAR2(m_detector_size,type);
+	maxImageSizeChanged(m_detector_size,type);
+    }
+}
+
+//-----------------------------------------------------
+// Acquisition thread core affinity, empty list means no affinity.
+// Applied at the next acquisition start.
+//-----------------------------------------------------
+void Camera::setAcqThreadAffinity(const std::string& cpu_list)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(cpu_list);
+#ifdef __unix
+    cpu_set_t cpu_set;
+    _parse_cpu_list(cpu_list,cpu_set);
+#endif
+    m_acq_thread_affinity = cpu_list;
+    m_acq_thread_settings_changed = true;
+}
+
+//-----------------------------------------------------
+// Acquisition thread scheduling, real-time policies need the
+// rtprio limit (see documentation).
+//-----------------------------------------------------
+void Camera::setAcqThreadScheduling(ThreadPolicy policy,int priority)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(policy,priority);
+#ifdef __unix
+    _check_sched_priority(policy,priority);
+#endif
+    m_acq_thread_policy = policy;
+    m_acq_thread_priority = priority;
+    m_acq_thread_settings_changed = true;
+}
+
+//-----------------------------------------------------
+// Settings in effect for the acquisition thread, as read back
+// from the system when they were applied.
+//-----------------------------------------------------
+void Camera::getAcqThreadSettings(std::string& cpu_list,ThreadPolicy& policy,
+				  int& priority) const
+{
+    DEB_MEMBER_FUNCT();
+    cpu_list = m_effective_acq_thread_affinity;
+    policy = m_effective_acq_thread_policy;
+    priority = m_effective_acq_thread_priority;
+    DEB_RETURN() << DEB_VAR3(cpu_list,policy,priority);
+}
+
+//-----------------------------------------------------
+// Pylon receive thread core affinity, applied when the stream
+// grabber is opened.
+//-----------------------------------------------------
+void Camera::setReceiveThreadAffinity(const std::string& cpu_list)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(cpu_list);
+#ifdef __unix
+    cpu_set_t cpu_set;
+    _parse_cpu_list(cpu_list,cpu_set);
+#endif
+    m_receive_affinity = cpu_list;
+}
+
+//-----------------------------------------------------
+// Pylon receive thread real-time priority, 0 keeps the Pylon default
+//-----------------------------------------------------
+void Camera::setReceiveThreadPriority(int priority)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(priority);
+    if(priority < 0)
+      THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(priority);
+    m_receive_priority = priority;
+}
+
+//-----------------------------------------------------
+// Receive thread affinity and the priority reported by Pylon
+//-----------------------------------------------------
+void Camera::getReceiveThreadSettings(std::string& cpu_list,int& priority) const
+{
+    DEB_MEMBER_FUNCT();
+    cpu_list = m_receive_affinity;
+    priority = m_effective_receive_priority;
+    DEB_RETURN() << DEB_VAR2(cpu_list,priority);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_checkThreadSettings()
+{
+    DEB_MEMBER_FUNCT();
+#ifdef __unix
+    cpu_set_t cpu_set;
+    _parse_cpu_list(m_acq_thread_affinity,cpu_set);
+    _parse_cpu_list(m_receive_affinity,cpu_set);
+    _check_sched_priority(m_acq_thread_policy,m_acq_thread_priority);
+#endif
+}
+
+//-----------------------------------------------------
+// Called by the acquisition thread itself
+//-----------------------------------------------------
+void Camera::_applyAcqThreadSettings()
+{
+    DEB_MEMBER_FUNCT();
+    m_acq_thread_settings_changed = false;
+#ifdef __unix
+    pthread_t self = pthread_self();
+    cpu_set_t cpu_set;
+    try
+    {
+	CPU_ZERO(&cpu_set);
+	if(m_acq_thread_affinity.empty())
+	  for(int cpu = 0;cpu < int(sysconf(_SC_NPROCESSORS_ONLN));++cpu)
+	    CPU_SET(cpu,&cpu_set);
+	else
+	  _parse_cpu_list(m_acq_thread_affinity,cpu_set);
+	if(pthread_setaffinity_np(self,sizeof(cpu_set),&cpu_set))
+	  DEB_ERROR() << "Can't set acquisition thread affinity to "
+		      << m_acq_thread_affinity;
+    }
+    catch (Exception &e)
+    {
+	DEB_ERROR() << e.getErrMsg();
+    }
+
+    struct sched_param param;
+    param.sched_priority = m_acq_thread_priority;
+    int ret = pthread_setschedparam(self,_get_sched_policy(m_acq_thread_policy),&param);
+    if(ret)
+      DEB_ERROR() << "Can't set acquisition thread scheduling: " << strerror(ret);
+
+    // report what is really in effect
+    if(!pthread_getaffinity_np(self,sizeof(cpu_set),&cpu_set))
+      m_effective_acq_thread_affinity = _cpu_set_to_string(cpu_set);
+    int policy;
+    if(!pthread_getschedparam(self,&policy,&param))
+    {
+	m_effective_acq_thread_policy = policy == SCHED_FIFO ? SchedFifo :
+	  policy == SCHED_RR ? SchedRR : SchedOther;
+	m_effective_acq_thread_priority = param.sched_priority;
+    }
+    DEB_TRACE() << DEB_VAR3(m_effective_acq_thread_affinity,
+			    m_effective_acq_thread_policy,
+			    m_effective_acq_thread_priority);
+#endif
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_setReceiveThreadPriority()
+{
+    DEB_MEMBER_FUNCT();
+    //Change priority to m_receive_priority
+    GenApi::INodeMap* nodemap = StreamGrabber_->GetNodeMap();
+    GenApi::CIntegerPtr priority = nodemap->GetNode("ReceiveThreadPriority");
+    if(!priority.IsValid() || !GenApi::IsReadable(priority))
+    {
+	m_effective_receive_priority = -1;
+	return;
+    }
+    if(m_receive_priority > 0)
+    {
+	GenApi::CBooleanPtr priority_override = nodemap->GetNode("ReceiveThreadPriorityOverride");
+	if(priority_override.IsValid() && GenApi::IsWritable(priority_override))
+	  priority_override->SetValue(true);
+	priority->SetValue(m_receive_priority);
+    }
+    m_effective_receive_priority = int(priority->GetValue());
+    DEB_TRACE() << DEB_VAR1(m_effective_receive_priority);
+}
+
+//-----------------------------------------------------
+// Select a stream grabber tuning profile and persist it for this
+// camera, it's reloaded at the next open. The profiles made for
+// this camera ("auto-tuned", "custom") are read back from its
+// config file. For a monochrome camera it takes effect at the
+// next prepareAcq.
+//-----------------------------------------------------
+void Camera::setStreamProfile(const std::string& name)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(name);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    int profile;
+    for(profile = 0;StreamProfiles[profile].name;++profile)
+      if(name == StreamProfiles[profile].name) break;
+    std::map<std::string,std::vector<long> >::const_iterator camera_profile =
+      m_camera_stream_profiles.find(name);
+    if(!StreamProfiles[profile].name && camera_profile == m_camera_stream_profiles.end())
+      THROW_HW_ERROR(InvalidValue) << "Unknown stream profile: " << name;
+    _checkNotRunning();
+
+    for(int i = 0;i < NB_STREAM_PARAMETERS;++i)
+      m_stream_params[i] = StreamProfiles[profile].name ?
+	StreamProfiles[profile].values[i] : camera_profile->second[i];
+    _saveStreamProfile(name);
+
+    if(m_color_flag)
+    {
+	try
+	{
+	    _freeStreamGrabber();
+	    _initColorStreamGrabber();
+	}
+	catch (GenICam::GenericException &e)
+	{
+	    THROW_HW_ERROR(Error) << e.GetDescription();
+	}
+    }
+}
+
+void Camera::getStreamProfile(std::string& name) const
+{
+    DEB_MEMBER_FUNCT();
+    name = m_stream_profile;
+    DEB_RETURN() << DEB_VAR1(name);
+}
+
+//-----------------------------------------------------
+// Set the tuning parameters on the freshly opened stream grabber,
+// the values in effect are reported by getStreamStatistics.
+//-----------------------------------------------------
+void Camera::_applyStreamParameters()
+{
+    DEB_MEMBER_FUNCT();
+    GenApi::INodeMap* nodemap = StreamGrabber_->GetNodeMap();
+    long effective[NB_STREAM_PARAMETERS];
+    for(int i = 0;i < NB_STREAM_PARAMETERS;++i)
+      effective[i] = _set_stream_param(nodemap,StreamParameterNames[i],m_stream_params[i]);
+
+    AutoMutex aLock(m_stats_lock);
+    for(int i = 0;i < NB_STREAM_PARAMETERS;++i)
+      m_effective_stream_params[i] = effective[i];
+    DEB_TRACE() << DEB_VAR1(m_stream_profile);
+    for(int i = 0;i < NB_STREAM_PARAMETERS;++i)
+      DEB_TRACE() << StreamParameterNames[i] << " = " << effective[i];
+}
+
+//-----------------------------------------------------
+// <config dir>/<serial number>.cfg, the config dir is
+// $LIMA_BASLER_CONFIG_DIR or ~/.lima/basler
+//-----------------------------------------------------
+std::string Camera::_getStreamProfileFile() const
+{
+    return _get_config_dir() + "/" + m_device_info.GetSerialNumber().c_str() + ".cfg";
+}
+
+//-----------------------------------------------------
+// Read the persisted profile as "key=value" lines, a missing
+// file keeps the Pylon defaults. The values of the profiles made
+// for this camera are kept as "<profile>.<parameter>=value".
+//-----------------------------------------------------
+void Camera::_loadStreamProfile()
+{
+    DEB_MEMBER_FUNCT();
+    std::string filename = _getStreamProfileFile();
+    std::ifstream file(filename.c_str());
+    if(!file)
+    {
+	DEB_TRACE() << "No stream profile saved in " << filename;
+	return;
+    }
+
+    std::string line;
+    while(std::getline(file,line))
+    {
+	std::string::size_type pos = line.find('=');
+	if(line.empty() || line[0] == '#' || pos == std::string::npos)
+	  continue;
+	std::string key = line.substr(0,pos);
+	std::string value = line.substr(pos + 1);
+	std::string::size_type dot = key.find('.');
+	if(dot != std::string::npos)
+	{
+	    std::vector<long>& values = m_camera_stream_profiles[key.substr(0,dot)];
+	    values.resize(NB_STREAM_PARAMETERS,-1);
+	    for(int i = 0;i < NB_STREAM_PARAMETERS;++i)
+	      if(key.substr(dot + 1) == StreamParameterNames[i])
+		values[i] = atol(value.c_str());
+	}
+	else if(key == "profile")
+	  m_stream_profile = value;
+	else if(key == "PacketSize")
+	  m_tuned_packet_size = atoi(value.c_str());
+	else if(key == "InterPacketDelay")
+	  m_tuned_inter_packet_delay = atoi(value.c_str());
+	else
+	  for(int i = 0;i < NB_STREAM_PARAMETERS;++i)
+	    if(key == StreamParameterNames[i])
+	      m_stream_params[i] = atol(value.c_str());
+    }
+    // written before the camera profiles were kept apart
+    int profile = 0;
+    while(StreamProfiles[profile].name && m_stream_profile != StreamProfiles[profile].name)
+      ++profile;
+    if(!StreamProfiles[profile].name && !m_camera_stream_profiles.count(m_stream_profile))
+      m_camera_stream_profiles[m_stream_profile].assign(m_stream_params,
+							m_stream_params + NB_STREAM_PARAMETERS);
+    DEB_TRACE() << "Loaded stream profile " << m_stream_profile << " from " << filename;
+}
+
+//-----------------------------------------------------
+// A name which isn't a predefined profile is a profile of this
+// camera, its values are also kept to be selected again.
+//-----------------------------------------------------
+void Camera::_saveStreamProfile(const std::string& name)
+{
+    DEB_MEMBER_FUNCT();
+    int profile = 0;
+    while(StreamProfiles[profile].name && name != StreamProfiles[profile].name)
+      ++profile;
+    if(!StreamProfiles[profile].name)
+      m_camera_stream_profiles[name].assign(m_stream_params,
+					    m_stream_params + NB_STREAM_PARAMETERS);
+
+    std::string filename = _getStreamProfileFile();
+    _make_dirs(_get_config_dir());
+    std::ofstream file(filename.c_str());
+    file << "# Basler " << m_device_info.GetModelName().c_str() << " stream profile\n";
+    file << "profile=" << name << "\n";
+    for(int i = 0;i < NB_STREAM_PARAMETERS;++i)
+      file << StreamParameterNames[i] << "=" << m_stream_params[i] << "\n";
+    for(std::map<std::string,std::vector<long> >::const_iterator i =
+	  m_camera_stream_profiles.begin();i != m_camera_stream_profiles.end();++i)
+      for(int j = 0;j < NB_STREAM_PARAMETERS;++j)
+	file << i->first << "." << StreamParameterNames[j] << "=" << i->second[j] << "\n";
+    if(m_tuned_packet_size > 0)
+      file << "PacketSize=" << m_tuned_packet_size << "\n";
+    if(m_tuned_inter_packet_delay >= 0)
+      file << "InterPacketDelay=" << m_tuned_inter_packet_delay << "\n";
+    file.close();
+    if(!file)
+      THROW_HW_ERROR(Error) << "Can't save stream profile in " << filename;
+    m_stream_profile = name;
+}
+
+//-----------------------------------------------------
+// Transport self calibration with the real camera and link.
+// Each point of the sweep is a point_duration seconds free running
+// acquisition, the achieved frame rate and the losses are taken from
+// the stream statistics. For a given socket buffer and packet size,
+// the inter-packet delay is only raised until the stream is lossless.
+//-----------------------------------------------------
+void Camera::autoTuneTransport(const std::string& report_file,double point_duration)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(report_file,point_duration);
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    if(point_duration <= 0.)
+      THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(point_duration);
+    if(m_transport != GigE)
+      THROW_HW_ERROR(NotSupported) << "Transport auto-tune is only for GigE cameras";
+    _checkNotRunning();
+
+    static const int PacketSizes[] = {9000,8192,6000,4000,1500,0};
+    static const int InterPacketDelays[] = {0,100,500,1000,2000,5000,-1};
+    static const long SocketBufferSizes[] = {2048,8192,16384,0};
+
+    std::ofstream report(report_file.c_str());
+    if(!report)
+      THROW_HW_ERROR(Error) << "Can't open report file " << report_file;
+
+    TrigMode trig_mode = m_trig_mode;
+    long socket_buffer_size = m_stream_params[0];
+    bool found = false;
+    int best_packet_size = 0,best_inter_packet_delay = 0;
+    long best_socket_buffer_size = 0;
+    double best_fps = 0.;
+    long best_resend_requests = 0;
+    try
+    {
+	_freeStreamGrabber();
+	setTrigMode(IntTrig);
+	_saveConfig();
+
+	report << "# Basler " << m_detector_model << " serial "
+	       << m_device_info.GetSerialNumber().c_str() << "\n"
+	       << "# roi " << m_config.roi << " binning " << m_config.bin_x << "x"
+	       << m_config.bin_y << " payload " << ImageSize_ << " bytes\n"
+	       << "# packet_size inter_packet_delay socket_buffer_size(KB) "
+	       << "fps failed_buffers lost_packets resend_requests\n";
+
+	for(const long* sb = SocketBufferSizes;*sb;++sb)
+	  for(const int* ps = PacketSizes;*ps;++ps)
+	  {
+	      if(*ps > Camera_->GevSCPSPacketSize.GetMax() ||
+		 *ps < Camera_->GevSCPSPacketSize.GetMin())
+		continue;
+	      for(const int* ipd = InterPacketDelays;*ipd >= 0;++ipd)
+	      {
+		  if(*ipd > Camera_->GevSCPD.GetMax())
+		    break;
+		  Camera_->GevSCPSPacketSize.SetValue(*ps);
+		  Camera_->GevSCPD.SetValue(*ipd);
+		  m_stream_params[0] = *sb;
+
+		  double fps;
+		  long failed_buffers,lost_packets,resend_requests;
+		  _measureTransport(point_duration,fps,failed_buffers,
+				    lost_packets,resend_requests);
+		  report << *ps << " " << *ipd << " " << *sb << " " << fps << " "
+			 << failed_buffers << " " << lost_packets << " "
+			 << resend_requests << std::endl;
+
+		  if(failed_buffers || lost_packets > 0)
+		    continue;
+		  if(!found || fps > best_fps * 1.01 ||
+		     (fps > best_fps * .99 && resend_requests < best_resend_requests))
+		  {
+		      found = true;
+		      best_packet_size = *ps;
+		      best_inter_packet_delay = *ipd;
+		      best_socket_buffer_size = *sb;
+		      best_fps = fps;
+		      best_resend_requests = resend_requests;
+		  }
+		  break;	// more delay can only be slower
+	      }
+	  }
+
+	if(found)
+	{
+	    report << "# selected " << best_packet_size << " " << best_inter_packet_delay
+		   << " " << best_socket_buffer_size << " " << best_fps << " fps\n";
+	    m_config.packet_size = best_packet_size;
+	    m_config.inter_packet_delay = best_inter_packet_delay;
+	    m_tuned_packet_size = best_packet_size;
+	    m_tuned_inter_packet_delay = best_inter_packet_delay;
+	    m_stream_params[0] = best_socket_buffer_size;
+	}
+	else
+	{
+	    report << "# no lossless configuration found, nothing changed\n";
+	    m_stream_params[0] = socket_buffer_size;
+	}
+	_applyConfig();
+	if(m_color_flag)
+	  _initColorStreamGrabber();
+    }
+    catch (GenICam::GenericException &e)
+    {
+	std::string error = e.GetDescription();
+	m_stream_params[0] = socket_buffer_size;
+	try
+	{
+	    Camera_->AcquisitionStop.Execute();
+	    _freeStreamGrabber();
+	}
+	catch (GenICam::GenericException &e)
+	{
+	    DEB_WARNING() << e.GetDescription();
+	    StreamGrabber_ = NULL;
+	}
+	m_trig_mode = trig_mode;
+	_applyConfig();
+	if(m_color_flag)
+	  _initColorStreamGrabber();
+	THROW_HW_ERROR(Error) << error;
+    }
+    setTrigMode(trig_mode);
+    _saveConfig();
+    if(!found)
+      THROW_HW_ERROR(Error) << "No lossless transport configuration found, see "
+			    << report_file;
+    _saveStreamProfile("auto-tuned");
+    DEB_TRACE() << DEB_VAR4(best_packet_size,best_inter_packet_delay,
+			    best_socket_buffer_size,best_fps);
+}
+
+//-----------------------------------------------------
+// One point of the transport sweep, with a private stream grabber
+// so Lima buffers are left untouched.
+// The buffers are local, the stream grabber is freed here on error
+// so none of them is still queued when they go out of scope.
+//-----------------------------------------------------
+void Camera::_measureTransport(double duration,double& fps,long& failed_buffers,
+			       long& lost_packets,long& resend_requests)
+{
+    DEB_MEMBER_FUNCT();
+    ImageSize_ = (size_t)(Camera_->PayloadSize.GetValue());
+    std::vector<char> buffers(ImageSize_ * NB_TUNE_BUFFER);
+    try
+    {
+	StreamGrabber_ = Camera_->GetStreamGrabber(0);
+	_setReceiveThreadPriority();
+	{
+	    _ThreadAffinityGuard affinity(m_receive_affinity);
+	    StreamGrabber_->Open();
+	}
+	_applyStreamParameters();
+	_set_grabber_param(StreamGrabber_,"MaxBufferSize",ImageSize_);
+	_set_grabber_param(StreamGrabber_,"MaxNumBuffer",NB_TUNE_BUFFER);
+	StreamGrabber_->PrepareGrab();
+
+	for(int i = 0;i < NB_TUNE_BUFFER;++i)
+	  StreamGrabber_->QueueBuffer(StreamGrabber_->RegisterBuffer(&buffers[i * ImageSize_],
+								      (const size_t)ImageSize_),NULL);
+
+	GenApi::INodeMap* nodemap = StreamGrabber_->GetNodeMap();
+	long lost_start = _get_stream_counter(nodemap,"Statistic_Failed_Packet_Count");
+	long resend_start = _get_stream_counter(nodemap,"Statistic_Resend_Request_Count");
+
+	long nb_frames = 0;
+	failed_buffers = 0;
+	Camera_->AcquisitionStart.Execute();
+	Timestamp start = Timestamp::now();
+	double elapsed;
+	while((elapsed = Timestamp::now() - start) < duration)
+	{
+	    if(!StreamGrabber_->GetWaitObject().Wait(100))
+	      continue;
+	    GrabResult Result;
+	    if(!StreamGrabber_->RetrieveResult(Result))
+	      continue;
+	    if(Result.Succeeded())
+	      ++nb_frames;
+	    else
+	      ++failed_buffers;
+	    StreamGrabber_->QueueBuffer(Result.Handle(),NULL);
+	}
+	Camera_->AcquisitionStop.Execute();
+
+	lost_packets = _get_stream_counter(nodemap,"Statistic_Failed_Packet_Count");
+	if(lost_packets >= 0 && lost_start >= 0) lost_packets -= lost_start;
+	resend_requests = _get_stream_counter(nodemap,"Statistic_Resend_Request_Count");
+	if(resend_requests >= 0 && resend_start >= 0) resend_requests -= resend_start;
+	fps = nb_frames / elapsed;
+	_freeStreamGrabber();
+    }
+    catch (GenICam::GenericException &e)
+    {
+	DEB_ERROR() << e.GetDescription();
+	try
+	{
+	    Camera_->AcquisitionStop.Execute();
+	    _freeStreamGrabber();
+	}
+	catch (GenICam::GenericException &e)
+	{
+	    DEB_WARNING() << e.GetDescription();
+	    StreamGrabber_ = NULL;
+	}
+	throw;
+    }
+    DEB_RETURN() << DEB_VAR4(fps,failed_buffers,lost_packets,resend_requests);
+}
+
+//-----------------------------------------------------
+// USB3 Vision stream parameters, saved as a "custom" stream profile
+//-----------------------------------------------------
+void Camera::setUsbStreamParameters(int max_transfer_size,int nb_max_queued_urbs)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(max_transfer_size,nb_max_queued_urbs);
+    if(m_transport != Usb)
+      THROW_HW_ERROR(NotSupported) << "Not a USB camera";
+    if(max_transfer_size <= 0 || nb_max_queued_urbs <= 0)
+      THROW_HW_ERROR(InvalidValue) << "Invalid "
+				   << DEB_VAR2(max_transfer_size,nb_max_queued_urbs);
+    _checkNotRunning();
+    m_stream_params[6] = max_transfer_size;
+    m_stream_params[7] = nb_max_queued_urbs;
+    _saveStreamProfile("custom");
+}
+
+void Camera::getTransport(Transport& transport) const
+{
+    DEB_MEMBER_FUNCT();
+    transport = m_transport;
+    DEB_RETURN() << DEB_VAR1(transport);
+}
+
+//-----------------------------------------------------
+// m_camera_id is looked up as an IP address or a DNS name first,
+// the GigE device is then created without any enumeration (fast
+// startup, also for cameras on a routed network). Otherwise it's
+// a serial number or a user defined name, looked up on all the
+// transport layers. Serial numbers are only digits, which is never
+// a host name, so they skip the DNS lookup.
+//-----------------------------------------------------
+void Camera::_findDevice(CDeviceInfo& device_info)
+{
+    DEB_MEMBER_FUNCT();
+    std::string camera_ip;
+    if(m_camera_id.find_first_not_of("0123456789") != std::string::npos)
+    {
+	try
+	{
+	    camera_ip = _get_ip_addresse(m_camera_id.c_str());
+	}
+	catch (Exception&)
+	{
+	    DEB_TRACE() << m_camera_id << " is not a host name";
+	}
+    }
+    if(!camera_ip.empty())
+    {
+	CBaslerGigEDeviceInfo di;
+	di.SetIpAddress(Pylon::String_t(camera_ip.c_str()));
+	device_info = di;
+	return;
+    }
+
+    CTlFactory& TlFactory = CTlFactory::GetInstance();
+    DeviceInfoList_t devices;
+    TlFactory.EnumerateDevices(devices);
+    for(DeviceInfoList_t::iterator i = devices.begin();i != devices.end();++i)
+      if(m_camera_id == i->GetSerialNumber().c_str() ||
+	 m_camera_id == i->GetUserDefinedName().c_str())
+      {
+	  DEB_TRACE() << "Found " << i->GetFullName() << " on "
+		      << i->GetDeviceClass();
+	  device_info = *i;
+	  return;
+      }
+    THROW_HW_ERROR(Error) << "Unable to find camera " << m_camera_id;
+}
+
+//-----------------------------------------------------
+// Resolve once the features depending on the transport, so
+// nothing is looked up by name afterwards.
+//-----------------------------------------------------
+void Camera::_resolveFeatures()
+{
+    DEB_MEMBER_FUNCT();
+    GenApi::INodeMap& nodemap = Camera_->GetNodeMap();
+    m_exposure_time_node = _get_node(nodemap,"ExposureTimeAbs","ExposureTime");
+    m_frame_rate_node = _get_node(nodemap,"AcquisitionFrameRateAbs","AcquisitionFrameRate");
+    m_resulting_frame_rate_node = _get_node(nodemap,"ResultingFrameRateAbs",
+					    "ResultingFrameRate");
+    m_gain_node = nodemap.GetNode("Gain");
+    m_heartbeat_node = nodemap.GetNode("Width");
+    DEB_TRACE() << DEB_VAR1(m_transport);
+}
+
+//-----------------------------------------------------
+// GigE cameras have an AcquisitionStart trigger, USB3 Vision
+// cameras a FrameBurstStart one.
+//-----------------------------------------------------
+bool Camera::_selectAcquisitionStartTrigger()
+{
+    static const char* TriggerNames[] = {"AcquisitionStart","FrameBurstStart",NULL};
+    for(const char** pt = TriggerNames;*pt;++pt)
+    {
+	GenApi::IEnumEntry *anEntry = Camera_->TriggerSelector.GetEntryByName(*pt);
+	if(anEntry && GenApi::IsAvailable(anEntry))
+	{
+	    Camera_->TriggerSelector.SetIntValue(anEntry->GetValue());
+	    return true;
+	}
+    }
+    return false;
+}
+
+//-----------------------------------------------------
+// Sum (or average) nb_frames raw frames into one 32 bits frame,
+// the acquisition number of frames is the number of summed frames.
+// Takes effect at the next prepareAcq, 1 disables the accumulation.
+//-----------------------------------------------------
+void Camera::setAccumulation(int nb_frames,AccumulationMode mode)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(nb_frames,mode);
+    if(nb_frames < 1)
+      THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_frames);
+    if(m_color_flag && nb_frames > 1)
+      THROW_HW_ERROR(NotSupported) << "Accumulation is not supported on color cameras";
+    _checkNotRunning();
+
+    ImageType prev_type;
+    getImageType(prev_type);
+    {
+	AutoMutex aLock(m_process_lock);
+	m_accumulator.setNbFrames(nb_frames);
+	m_accumulator.setMode(mode == AccumulationAverage ?
+			      Accumulator::Average : Accumulator::Sum);
+    }
+    ImageType type;
+    getImageType(type);
+    if(type != prev_type)
+      maxImageSizeChanged(m_detector_size,type);
+}
+
+void Camera::getAccumulation(int& nb_frames,AccumulationMode& mode) const
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_accumulator.getNbFrames();
+    mode = m_accumulator.getMode() == Accumulator::Average ?
+      AccumulationAverage : AccumulationSum;
+    DEB_RETURN() << DEB_VAR2(nb_frames,mode);
+}
+
+//-----------------------------------------------------
+// Per pixel mean, variance, min and max of all the raw frames
+// of the run, reset at each prepareAcq.
+//-----------------------------------------------------
+void Camera::setRunStatistics(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if(m_color_flag && active)
+      THROW_HW_ERROR(NotSupported) << "Run statistics are not supported on color cameras";
+    _checkNotRunning();
+    AutoMutex aLock(m_process_lock);
+    m_accumulator.setRunStatistics(active);
+}
+
+void Camera::getRunStatistics(bool& active) const
+{
+    DEB_MEMBER_FUNCT();
+    active = m_accumulator.getRunStatistics();
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+// Copy of a run statistics map as a double image,
+// it can be read while the acquisition is running.
+//-----------------------------------------------------
+void Camera::getRunStatisticsMap(RunMap map,Data& data)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(map);
+    if(!m_accumulator.getRunStatistics())
+      THROW_HW_ERROR(Error) << "Run statistics are not active";
+
+    AutoMutex aLock(m_process_lock);
+    int nb_pixels = m_accumulator.getNbPixels();
+    Buffer* buffer = new Buffer(nb_pixels * sizeof(double));
+    data = Data();
+    data.type = Data::DOUBLE;
+    data.dimensions.push_back(m_process_size.getWidth());
+    data.dimensions.push_back(m_process_size.getHeight());
+    data.frameNumber = int(m_accumulator.getNbRunFrames());
+    data.setBuffer(buffer);
+    buffer->unref();
+
+    Accumulator::RunMap run_map;
+    switch(map)
+    {
+    case RunMean:	run_map = Accumulator::Mean;		break;
+    case RunVariance:	run_map = Accumulator::Variance;	break;
+    case RunMin:	run_map = Accumulator::Min;		break;
+    default:		run_map = Accumulator::Max;		break;
+    }
+    m_accumulator.getRunMap(run_map,(double*)buffer->data);
+}
+
+//-----------------------------------------------------
+//
+//-----------------------------------------------------
+void Camera::_allocRawBuffers(int nb_buffers)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_buffers);
+    // page aligned and padded, as needed by the O_DIRECT raw streaming
+    size_t size = RawWriter::getStride(ImageSize_);
+    for(int i = 0;i < nb_buffers;++i)
+    {
+	void* ptr;
+#ifdef __unix
+	if(posix_memalign(&ptr,RawWriter::ALIGNMENT,size))
+	  ptr = NULL;
+#else
+        ptr = _aligned_malloc(size,RawWriter::ALIGNMENT);
+#endif
+	if(!ptr)
+	{
+	    _freeRawBuffers();
+	    THROW_HW_ERROR(Error) << "Can't allocate raw buffers";
+	}
+	m_raw_buffers.push_back(ptr);
+    }
+}
+
+void Camera::_freeRawBuffers()
+{
+    for(std::vector<void*>::iterator i = m_raw_buffers.begin();
+	i != m_raw_buffers.end();++i)
+#ifdef __unix
+      free(*i);
+#else
+      _aligned_free(*i);
+#endif
+    m_raw_buffers.clear();
+}
+
+//-----------------------------------------------------
+// Called by the acquisition thread for each raw frame, dst is
+// the Lima buffer of the current frame or NULL if the frame was
+// grabbed in place or is not stored. Returns true when dst is complete.
+//-----------------------------------------------------
+bool Camera::_processFrame(const GrabResult& result,void* dst,double retrieve_time)
+{
+    AutoMutex aLock(m_process_lock);
+    void* raw = result.Buffer();
+    bool accumulate = dst && m_accumulator.getNbFrames() > 1;
+    void* frame = raw;
+    if(m_correction_active)
+    {
+	// corrected in place if accumulated afterwards or not stored
+	if(dst && !accumulate)
+	  frame = dst;
+	_CorrectionTask task(m_correction,raw,frame,m_process_depth,m_process_max_value);
+	m_worker_pool.run(task);
+	m_correction.replaceDefects(frame,m_process_depth);
+    }
+    if(m_beam_monitor_active)
+    {
+	m_beam_monitor.process(frame,_getFrameTimestamp(result,retrieve_time));
+    }
+    if(accumulate)
+    {
+	if(!m_accumulator.add(frame,(unsigned int*)dst))
+	  return false;
+	frame = dst;
+    }
+    else
+    {
+	if(dst && frame != dst)
+	{
+	    memcpy(dst,frame,ImageSize_);
+	    frame = dst;
+	}
+	m_accumulator.addToRun(frame);
+    }
+    if(m_compressed_ring.getSize() &&
+       !m_compressed_ring.add(m_image_number,frame,m_worker_pool))
+    {
+      DEB_MEMBER_FUNCT();
+      DEB_WARNING() << "Frame " << m_image_number << " doesn't fit in the compression buffer";
+    }
+    if(m_shm_ring.isOpen())
+      m_shm_ring.publish(frame,m_image_number,_getFrameTimestamp(result,retrieve_time),
+			 result.GetTimeStamp());
+    if(m_preview.isDue(retrieve_time))
+      m_preview.update(frame,m_process_size.getWidth(),m_process_size.getHeight(),
+		       accumulate ? 4 : m_process_depth,1,m_image_number,retrieve_time,
+		       _getFrameTimestamp(result,retrieve_time));
+    return true;
+}
+
+//-----------------------------------------------------
+// Host time of the frame, from the camera clock when it was latched
+//-----------------------------------------------------
+double Camera::_getFrameTimestamp(const GrabResult& result,double retrieve_time) const
+{
+    if(m_cam_tick_period > 0.)
+      return double(result.GetTimeStamp()) * m_cam_tick_period + m_cam_time_offset;
+    return retrieve_time;
+}
+
+//-----------------------------------------------------
+// Correction tables are updated on a copy and swapped in,
+// the acquisition thread only waits for the swap.
+//-----------------------------------------------------
+void Camera::setCorrectionDark(const Data& dark)
+{
+    DEB_MEMBER_FUNCT();
+    Correction correction;
+    _getCorrection(correction);
+    std::vector<float> table;
+    _data_to_table(dark,correction.getWidth(),correction.getHeight(),table);
+    correction.setDark(table);
+    _setCorrection(correction);
+}
+
+void Camera::setCorrectionFlat(const Data& flat)
+{
+    DEB_MEMBER_FUNCT();
+    Correction correction;
+    _getCorrection(correction);
+    std::vector<float> table;
+    _data_to_table(flat,correction.getWidth(),correction.getHeight(),table);
+    correction.setFlat(table);
+    _setCorrection(correction);
+}
+
+void Camera::setCorrectionDefects(const Data& defects)
+{
+    DEB_MEMBER_FUNCT();
+    Correction correction;
+    _getCorrection(correction);
+    std::vector<float> table;
+    _data_to_table(defects,correction.getWidth(),correction.getHeight(),table);
+    std::vector<unsigned char> mask(table.size());
+    for(size_t i = 0;i < table.size();++i)
+      mask[i] = table[i] != 0.f;
+    correction.setDefects(mask);
+    _setCorrection(correction);
+    DEB_TRACE() << "Nb defective pixels " << correction.getNbDefects();
+}
+
+void Camera::resetCorrection()
+{
+    DEB_MEMBER_FUNCT();
+    Correction correction;
+    _getCorrection(correction);
+    correction.clear();
+    _setCorrection(correction);
+}
+
+//-----------------------------------------------------
+// Takes effect at the next prepareAcq, as corrected frames are
+// grabbed through the raw buffers.
+//-----------------------------------------------------
+void Camera::setCorrectionActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if(m_color_flag && active)
+      THROW_HW_ERROR(NotSupported) << "Correction is not supported on color cameras";
+    _checkNotRunning();
+    m_correction_active = active;
+}
+
+void Camera::getCorrectionActive(bool& active) const
+{
+    DEB_MEMBER_FUNCT();
+    active = m_correction_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+// Number of threads sharing the processing of a frame,
+// including the acquisition thread.
+//-----------------------------------------------------
+void Camera::setProcessingThreads(int nb_threads)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_threads);
+    _checkNotRunning();
+    m_worker_pool.setNbThreads(nb_threads);
+}
+
+void Camera::getProcessingThreads(int& nb_threads) const
+{
+    DEB_MEMBER_FUNCT();
+    nb_threads = m_worker_pool.getNbThreads();
+    DEB_RETURN() << DEB_VAR1(nb_threads);
+}
+
+//-----------------------------------------------------
+// Copy of the current tables, cleared if the image size changed
+//-----------------------------------------------------
+void Camera::_getCorrection(Correction& correction)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aDeviceLock(m_device_lock);
+    _checkCamera();
+    int width,height;
+    try
+    {
+	width = int(Camera_->Width.GetValue());
+	height = int(Camera_->Height.GetValue());
+    }
+    catch (GenICam::GenericException &e)
+    {
+        THROW_HW_ERROR(Error) << e.GetDescription();
+    }
+    {
+	AutoMutex aLock(m_process_lock);
+	correction = m_correction;
+    }
+    correction.setSize(width,height);
+}
+
+void Camera::_setCorrection(Correction& correction)
+{
+    AutoMutex aLock(m_process_lock);
+    m_correction.swap(correction);
+}
+
+//-----------------------------------------------------
+// Beam monitor, statistics are computed on the raw (or corrected)
+// frames by the acquisition thread while they are still in cache.
+//-----------------------------------------------------
+void Camera::addBeamMonitorRoi(const Roi& roi)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(roi);
+    _checkNotRunning();
+    if(roi.getSize().getWidth() <= 0 || roi.getSize().getHeight() <= 0)
+      THROW_HW_ERROR(InvalidValue) << "Empty beam monitor roi";
+
+    AutoMutex aLock(m_process_lock);
+    std::vector<BeamMonitor::Roi> rois = m_beam_monitor.getRois();
+    BeamMonitor::Roi beam_roi;
+    beam_roi.x = roi.getTopLeft().x;
+    beam_roi.y = roi.getTopLeft().y;
+    beam_roi.width = roi.getSize().getWidth();
+    beam_roi.height = roi.getSize().getHeight();
+    rois.push_back(beam_roi);
+    m_beam_monitor.setRois(rois);
+}
+
+void Camera::resetBeamMonitorRois()
+{
+    DEB_MEMBER_FUNCT();
+    _checkNotRunning();
+    AutoMutex aLock(m_process_lock);
+    m_beam_monitor.setRois(std::vector<BeamMonitor::Roi>());
+}
+
+void Camera::getBeamMonitorNbRois(int& nb_rois) const
+{
+    DEB_MEMBER_FUNCT();
+    nb_rois = int(m_beam_monitor.getRois().size());
+    DEB_RETURN() << DEB_VAR1(nb_rois);
+}
+
+void Camera::setBeamMonitorActive(bool active)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(active);
+    if(m_color_flag && active)
+      THROW_HW_ERROR(NotSupported) << "Beam monitor is not supported on color cameras";
+    _checkNotRunning();
+    m_beam_monitor_active = active;
+}
+
+void Camera::getBeamMonitorActive(bool& active) const
+{
+    DEB_MEMBER_FUNCT();
+    active = m_beam_monitor_active;
+    DEB_RETURN() << DEB_VAR1(active);
+}
+
+//-----------------------------------------------------
+// When the frames are not stored, the acquisition delivers no image
+// to Lima, only the beam statistics. Under Lima control it must
+// then be a live acquisition (0 frames), stopped by stopAcq.
+//-----------------------------------------------------
+void Camera::setBeamMonitorStoreFrames(bool store)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(store);
+    _checkNotRunning();
+    m_beam_store_frames = store;
+}
+
+void Camera::getBeamMonitorStoreFrames(bool& store) const
+{
+    DEB_MEMBER_FUNCT();
+    store = m_beam_store_frames;
+    DEB_RETURN() << DEB_VAR1(store);
+}
+
+void Camera::setBeamMonitorHistory(int nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_frames);
+    if(nb_frames < 1)
+      THROW_HW_ERROR(InvalidValue) << "History must be at least one frame";
+    _checkNotRunning();
+    AutoMutex aLock(m_process_lock);
+    m_beam_monitor.setHistorySize(nb_frames);
+}
+
+void Camera::getBeamMonitorHistory(int& nb_frames) const
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_beam_monitor.getHistorySize();
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+// Statistics of the frames >= from_frame still in the history,
+// data.frameNumber is the next frame to read.
+//-----------------------------------------------------
+void Camera::readBeamStatistics(long from_frame,Data& data)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(from_frame);
+    std::vector<BeamMonitor::Stats> stats;
+    long nb_frames;
+    {
+	AutoMutex aLock(m_process_lock);
+	m_beam_monitor.read(from_frame,stats);
+	nb_frames = m_beam_monitor.getNbFrames();
+    }
+
+    data = Data();
+    data.frameNumber = int(nb_frames);
+    if(stats.empty())
+      return;
+
+    Buffer* buffer = new Buffer(int(stats.size() * NB_BEAM_VALUES * sizeof(double)));
+    data.type = Data::DOUBLE;
+    data.dimensions.push_back(NB_BEAM_VALUES);
+    data.dimensions.push_back(int(stats.size()));
+    data.setBuffer(buffer);
+    buffer->unref();
+
+    double* values = (double*)buffer->data;
+    for(std::vector<BeamMonitor::Stats>::iterator i = stats.begin();
+	i != stats.end();++i,values += NB_BEAM_VALUES)
+    {
+	values[BeamFrame] = double(i->frame_nb);
+	values[BeamTimestamp] = i->timestamp;
+	values[BeamRoi] = i->roi_index;
+	values[BeamSum] = i->sum;
+	values[BeamMax] = i->max;
+	values[BeamCentroidX] = i->centroid_x;
+	values[BeamCentroidY] = i->centroid_y;
+	values[BeamFwhmX] = i->fwhm_x;
+	values[BeamFwhmY] = i->fwhm_y;
+    }
+}
+
+//-----------------------------------------------------
+// Compressed frames are kept in an arena allocated here, the
+// compression shares the processing threads.
+//-----------------------------------------------------
+void Camera::setCompressionBufferSize(int size)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(size);
+    if(size < 0)
+      THROW_HW_ERROR(InvalidValue) << "Compression buffer size can't be negative";
+    if(size && !CompressedRing::isAvailable())
+      THROW_HW_ERROR(NotSupported) << "Plugin built without LZ4";
+    if(size && m_color_flag)
+      THROW_HW_ERROR(NotSupported) << "Compression is not supported on color cameras";
+    _checkNotRunning();
+
+    AutoMutex aLock(m_process_lock);
+    size_t nb_bytes = size_t(size) << 20;
+    m_compressed_ring.setSize(nb_bytes);
+    if(m_compressed_ring.getSize() != nb_bytes)
+      THROW_HW_ERROR(Error) << "Can't allocate " << size << " MB of compression buffer";
+}
+
+void Camera::getCompressionBufferSize(int& size) const
+{
+    DEB_MEMBER_FUNCT();
+    size = int(m_compressed_ring.getSize() >> 20);
+    DEB_RETURN() << DEB_VAR1(size);
+}
+
+void Camera::getCompressedFrames(long& first_frame,long& nb_frames)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_process_lock);
+    first_frame = m_compressed_ring.getFirstFrame();
+    nb_frames = m_compressed_ring.getNbFrames();
+    DEB_RETURN() << DEB_VAR2(first_frame,nb_frames);
+}
+
+void Camera::getCompressionRatio(double& ratio)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_process_lock);
+    ratio = m_compressed_ring.getRatio();
+    DEB_RETURN() << DEB_VAR1(ratio);
+}
+
+//-----------------------------------------------------
+// The compressed frame is copied under lock and
+// decompressed in the caller thread.
+//-----------------------------------------------------
+void Camera::readCompressedFrame(long frame_nb,Data& data)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(frame_nb);
+    std::vector<char> compressed;
+    bool found;
+    {
+	AutoMutex aLock(m_process_lock);
+	found = m_compressed_ring.get(frame_nb,compressed);
+    }
+    if(!found)
+      THROW_HW_ERROR(InvalidValue) << "Frame " << frame_nb << " is not in the compression buffer";
+
+    const CompressedRing::Header& header = CompressedRing::getHeader(compressed);
+    Buffer* buffer = new Buffer(int(header.width * header.height * header.depth));
+    data = Data();
+    switch(header.depth)
+    {
+    case 1:	data.type = Data::UINT8;	break;
+    case 2:	data.type = Data::UINT16;	break;
+    default:	data.type = Data::UINT32;	break;
+    }
+    data.dimensions.push_back(int(header.width));
+    data.dimensions.push_back(int(header.height));
+    data.frameNumber = int(frame_nb);
+    data.setBuffer(buffer);
+    buffer->unref();
+    CompressedRing::decompress(compressed,buffer->data);
+}
+
+//-----------------------------------------------------
+// Raw streaming, frames are written by the RawWriter thread straight
+// from the grab buffers, each buffer is queued back to the stream
+// grabber by the acquisition thread once written.
+// No image is delivered to Lima, under Lima control the acquisition
+// must be a live one (0 frames), stopped by stopAcq.
+//-----------------------------------------------------
+void Camera::setRawStreamFile(const std::string& filename)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(filename);
+    if(m_color_flag && !filename.empty())
+      THROW_HW_ERROR(NotSupported) << "Raw streaming is not supported on color cameras";
+#ifndef __unix
+    if(!filename.empty())
+      THROW_HW_ERROR(NotSupported) << "Raw streaming is only available on unix";
+#endif
+    _checkNotRunning();
+    m_raw_stream_file = filename;
+}
+
+void Camera::getRawStreamFile(std::string& filename) const
+{
+    DEB_MEMBER_FUNCT();
+    filename = m_raw_stream_file;
+    DEB_RETURN() << DEB_VAR1(filename);
+}
+
+void Camera::setRawStreamBuffers(int nb_buffers)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_buffers);
+    if(nb_buffers < RawWriter::MAX_BATCH)
+      THROW_HW_ERROR(InvalidValue) << "At least " << int(RawWriter::MAX_BATCH) << " buffers";
+    _checkNotRunning();
+    m_raw_stream_buffers = nb_buffers;
+}
+
+void Camera::getRawStreamBuffers(int& nb_buffers) const
+{
+    DEB_MEMBER_FUNCT();
+    nb_buffers = m_raw_stream_buffers;
+    DEB_RETURN() << DEB_VAR1(nb_buffers);
+}
+
+void Camera::getRawStreamStatistics(RawStreamStatistics& stats)
+{
+    DEB_MEMBER_FUNCT();
+    RawWriter::Statistics writer_stats;
+    m_raw_writer.getStatistics(writer_stats);
+    stats.nb_frames = writer_stats.nb_frames;
+    stats.throughput = writer_stats.throughput;
+    stats.queue_depth = writer_stats.queue_depth;
+    stats.max_queue_depth = writer_stats.max_queue_depth;
+    DEB_RETURN() << DEB_VAR4(stats.nb_frames,stats.throughput,
+			     stats.queue_depth,stats.max_queue_depth);
+}
+
+void Camera::_streamFrame(const GrabResult& result,double retrieve_time)
+{
+    RawWriter::FrameInfo info;
+    info.frame_nb = m_image_number;
+    info.timestamp = _getFrameTimestamp(result,retrieve_time);
+    info.camera_timestamp = result.GetTimeStamp();
+    info.status = 0;
+    info.reserved = 0;
+    m_raw_writer.write(result.Buffer(),result.Handle(),info);
+    if(m_preview.isDue(retrieve_time))
+      m_preview.update(result.Buffer(),m_process_size.getWidth(),m_process_size.getHeight(),
+		       m_process_depth,1,m_image_number,retrieve_time,info.timestamp);
+}
+
+void Camera::_requeueWrittenBuffers()
+{
+    std::vector<void*> handles;
+    m_raw_writer.getWritten(handles);
+    for(std::vector<void*>::iterator i = handles.begin();i != handles.end();++i)
+      StreamGrabber_->QueueBuffer(StreamBufferHandle(*i),NULL);
+}
+
+void Camera::_RawWriteCallback::framesWritten()
+{
+    m_cam.m_raw_write_done.Signal();
+}
+
+//-----------------------------------------------------
+// The shared memory is created at prepareAcq with the image size,
+// readers use ShmRing::Reader. Not used by the raw streaming.
+//-----------------------------------------------------
+void Camera::setShmRing(const std::string& name,int nb_slots)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(name,nb_slots);
+    if(m_color_flag && !name.empty())
+      THROW_HW_ERROR(NotSupported) << "Shared memory ring is not supported on color cameras";
+#ifndef __unix
+    if(!name.empty())
+      THROW_HW_ERROR(NotSupported) << "Shared memory ring is only available on unix";
+#endif
+    if(!name.empty() && (name[0] != '/' || name.find('/',1) != std::string::npos))
+      THROW_HW_ERROR(InvalidValue) << "Shared memory name must be /name";
+    if(nb_slots < 2)
+      THROW_HW_ERROR(InvalidValue) << "At least 2 slots";
+    _checkNotRunning();
+    m_shm_name = name;
+    m_shm_nb_slots = nb_slots;
+    if(name.empty())
+    {
+	AutoMutex aLock(m_process_lock);
+	m_shm_ring.close();
+    }
+}
+
+void Camera::getShmRing(std::string& name,int& nb_slots) const
+{
+    DEB_MEMBER_FUNCT();
+    name = m_shm_name;
+    nb_slots = m_shm_nb_slots;
+    DEB_RETURN() << DEB_VAR2(name,nb_slots);
+}
+
+void Camera::getShmRingPublished(long& nb_frames) const
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = long(m_shm_ring.getNbPublished());
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+// Trace ring of the acquisition events
+//-----------------------------------------------------
+static const char* TraceEventNames[] = {"AcqStart","AcqEnd","FrameRetrieved",
+					"FrameDelivered","FrameFailed","Status",
+					"Timeout"};
+
+void Camera::setTraceRingSize(int nb_events)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(nb_events);
+    AutoMutex aLock(m_cond.mutex());
+    if(m_thread_running)
+      THROW_HW_ERROR(Error) << "Can't resize the trace ring while acquiring";
+    m_trace_ring.setSize(nb_events);
+}
+
+void Camera::getTraceRingSize(int& nb_events) const
+{
+    DEB_MEMBER_FUNCT();
+    nb_events = m_trace_ring.getSize();
+    DEB_RETURN() << DEB_VAR1(nb_events);
+}
+
+void Camera::readTraceEvents(Data& data)
+{
+    DEB_MEMBER_FUNCT();
+    std::vector<TraceRing::Event> events;
+    m_trace_ring.read(events);
+
+    data = Data();
+    data.frameNumber = int(m_trace_ring.getNbRecorded());
+    if(events.empty())
+      return;
+
+    Buffer* buffer = new Buffer(int(events.size() * 4 * sizeof(double)));
+    data.type = Data::DOUBLE;
+    data.dimensions.push_back(4);
+    data.dimensions.push_back(int(events.size()));
+    data.setBuffer(buffer);
+    buffer->unref();
+
+    double* values = (double*)buffer->data;
+    for(std::vector<TraceRing::Event>::iterator i = events.begin();
+	i != events.end();++i,values += 4)
+    {
+	values[0] = i->timestamp;
+	values[1] = double(i->frame_nb);
+	values[2] = i->type;
+	values[3] = i->arg;
+    }
+}
+
+void Camera::dumpTraceEvents(const std::string& filename)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(filename);
+    std::vector<TraceRing::Event> events;
+    m_trace_ring.read(events);
+
+    std::ofstream f(filename.c_str());
+    if(!f)
+      THROW_HW_ERROR(Error) << "Can't open " << filename;
+    f << std::fixed;
+    f.precision(6);
+    for(std::vector<TraceRing::Event>::iterator i = events.begin();
+	i != events.end();++i)
+    {
+	const char* name = (i->type >= 0 && i->type <= TraceTimeout) ?
+	  TraceEventNames[i->type] : "Unknown";
+	f << i->timestamp << " " << i->frame_nb << " " << name << " " << i->arg << "\n";
+    }
+    if(!f)
+      THROW_HW_ERROR(Error) << "Error writing " << filename;
+}
+
+//-----------------------------------------------------
+// Preview tap
+//-----------------------------------------------------
+void Camera::setPreviewInterval(double interval)
+{
+    DEB_MEMBER_FUNCT();
+    m_preview.setInterval(interval);
+}
+
+void Camera::getPreviewInterval(double& interval) const
+{
+    DEB_MEMBER_FUNCT();
+    interval = m_preview.getInterval();
+    DEB_RETURN() << DEB_VAR1(interval);
+}
+
+void Camera::setPreviewDownsampling(int factor)
+{
+    DEB_MEMBER_FUNCT();
+    m_preview.setDownsampling(factor);
+}
+
+void Camera::getPreviewDownsampling(int& factor) const
+{
+    DEB_MEMBER_FUNCT();
+    factor = m_preview.getDownsampling();
+    DEB_RETURN() << DEB_VAR1(factor);
+}
+
+void Camera::getPreviewFrame(Data& data)
+{
+    DEB_MEMBER_FUNCT();
+    data = Data();
+    data.frameNumber = -1;
+    Preview::Frame frame;
+    if(!m_preview.getLast(frame))
+      return;
+
+    switch(frame.depth)
+    {
+    case 1: data.type = Data::UINT8;break;
+    case 2: data.type = Data::UINT16;break;
+    default: data.type = Data::UINT32;break;
+    }
+    if(frame.channels > 1)
+      data.dimensions.push_back(frame.channels);
+    data.dimensions.push_back(frame.width);
+    data.dimensions.push_back(frame.height);
+    data.frameNumber = int(frame.frame_nb);
+    data.timestamp = frame.timestamp;
+    Buffer* buffer = new Buffer(int(frame.data.size()));
+    memcpy(buffer->data,&frame.data[0],frame.data.size());
+    data.setBuffer(buffer);
+    buffer->unref();
+}
+
+//-----------------------------------------------------
+// Color frames are previewed from the grab buffer, raw
+// bayer frames are subsampled as they are.
+//-----------------------------------------------------
+void Camera::_previewColorFrame(const GrabResult& result,VideoMode mode,double retrieve_time)
+{
+    int depth = 1,channels = 1;
+    switch(mode)
+    {
+    case Y8: case BAYER_RG8: case BAYER_BG8:
+      break;
+    case Y16: case BAYER_RG16: case BAYER_BG16:
+      depth = 2;break;
+    case RGB24: case BGR24:
+      channels = 3;break;
+    case RGB32: case BGR32:
+      channels = 4;break;
+    default:
+      return;			// YUV
+    }
+    m_preview.update(result.Buffer(),result.GetSizeX(),result.GetSizeY(),depth,channels,
+		     m_image_number,retrieve_time,_getFrameTimestamp(result,retrieve_time));
+}
+
+//-----------------------------------------------------
+// Event notification
+//-----------------------------------------------------
+int Camera::getNotifyFd() const
+{
+    DEB_MEMBER_FUNCT();
+    int fd = m_notifier.getFd();
+    DEB_RETURN() << DEB_VAR1(fd);
+    return fd;
+}
+
+int Camera::readNotifyEvents()
+{
+    DEB_MEMBER_FUNCT();
+    int events = m_notifier.readEvents();
+    DEB_RETURN() << DEB_VAR1(events);
+    return events;
+}
+
+void Camera::registerNotifyCallback(NotifyCallback& cb)
+{
+    DEB_MEMBER_FUNCT();
+    m_notifier.registerCallback(cb);
+}
+
+void Camera::unregisterNotifyCallback(NotifyCallback& cb)
+{
+    DEB_MEMBER_FUNCT();
+    m_notifier.unregisterCallback(cb);
+}
+
+//-----------------------------------------------------
+// Pinned frames, the address is given to the python views
+// (see python/Basler.py) which unpin the frame when released.
+//-----------------------------------------------------
+void Camera::pinFrame(long frame_nb,unsigned long long& address,int& width,int& height,
+		      int& depth,int& channels,long& pinned_frame_nb)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(frame_nb);
+    if(!m_raw_stream_file.empty() || (m_beam_monitor_active && !m_beam_store_frames))
+      THROW_HW_ERROR(Error) << "Frames are not stored in the Lima buffers";
+
+    AutoMutex aLock(m_process_lock);
+    long last_frame = _getNbAcquiredFrames() - 1;
+    if(frame_nb < 0)
+      frame_nb = last_frame;
+    if(frame_nb < 0 || !_isFrameValid(frame_nb))
+      THROW_HW_ERROR(InvalidValue) << "Frame " << frame_nb << " is not available";
+
+    if(m_color_flag)
+    {
+	const _ColorFrame& color_frame = m_color_frames[frame_nb % NB_COLOR_BUFFER];
+	++m_color_pins[color_frame.buffer];
+	address = (unsigned long long)color_frame.ptr;
+	width = color_frame.width;
+	height = color_frame.height;
+	depth = 1;
+	channels = 1;
+	int yuv_size = 0;		// bytes per 2 pixels
+	switch(color_frame.mode)
+	{
+	case Y16: case BAYER_RG16: case BAYER_BG16:	depth = 2;	break;
+	case RGB24: case BGR24:				channels = 3;	break;
+	case RGB32: case BGR32:				channels = 4;	break;
+	case YUV411:					yuv_size = 3;	break;
+	case YUV422:					yuv_size = 4;	break;
+	case YUV444:					yuv_size = 6;	break;
+	default:							break;
+	}
+	if(yuv_size)
+	{
+	    channels = 0;
+	    width = width * height * yuv_size / 2;
+	    height = 1;
+	}
+    }
+    else
+    {
+	StdBufferCbMgr& buffer_mgr = m_buffer_ctrl_obj.getBuffer();
+	int nb_buffers;
+	buffer_mgr.getNbBuffers(nb_buffers);
+	FrameDim frame_dim;
+	buffer_mgr.getFrameDim(frame_dim);
+	address = (unsigned long long)buffer_mgr.getFrameBufferPtr(frame_nb % nb_buffers);
+	width = frame_dim.getSize().getWidth();
+	height = frame_dim.getSize().getHeight();
+	depth = frame_dim.getDepth();
+	channels = 1;
+	++m_frame_pins[address];
+    }
+    pinned_frame_nb = frame_nb;
+    ++m_nb_pinned_frames;
+    DEB_RETURN() << DEB_VAR5(address,width,height,depth,channels);
+}
+
+//-----------------------------------------------------
+// Pins are counted per address, an address which isn't pinned
+// is ignored. A color buffer is queued back once it's neither
+// pinned nor the buffer of the last frame.
+//-----------------------------------------------------
+void Camera::unpinFrame(unsigned long long address)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(address);
+    AutoMutex aDeviceLock(m_device_lock);
+    AutoMutex aLock(m_process_lock);
+    if(!m_color_flag)
+    {
+	std::map<unsigned long long,int>::iterator pin = m_frame_pins.find(address);
+	if(pin == m_frame_pins.end())
+	{
+	    DEB_WARNING() << "Address " << DEB_HEX(address) << " is not pinned";
+	    return;
+	}
+	if(!--pin->second)
+	  m_frame_pins.erase(pin);
+	--m_nb_pinned_frames;
+	return;
+    }
+    int i = 0;
+    while(i < NB_COLOR_BUFFER &&
+	  ((unsigned long long)m_color_buffer[i] != address || !m_color_pins[i]))
+      ++i;
+    if(i == NB_COLOR_BUFFER)
+    {
+	DEB_WARNING() << "Address " << DEB_HEX(address) << " is not pinned";
+	return;
+    }
+    --m_nb_pinned_frames;
+    if(!--m_color_pins[i] && i != m_color_last)
+    {
+	try
+	{
+	    _queueColorBuffer(i);
+	}
+	catch (GenICam::GenericException &e)
+	{
+	    DEB_ERROR() << e.GetDescription();
+	}
+    }
+}
+
+void Camera::getNbPinnedFrames(int& nb_frames) const
+{
+    DEB_MEMBER_FUNCT();
+    nb_frames = m_nb_pinned_frames;
+    DEB_RETURN() << DEB_VAR1(nb_frames);
+}
+
+//-----------------------------------------------------
+// A frame can be pinned if its buffer is out of the grab queue and
+// not written again. In video mode, it's the buffer of the last frame
+// or of a frame still pinned. The Lima buffers are written again while
+// the acquisition runs, except the ones of the last frames of a fixed
+// length acquisition.
+//-----------------------------------------------------
+bool Camera::isFrameValid(long frame_nb) const
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(const_cast<Mutex&>(m_process_lock));
+    bool valid = _isFrameValid(frame_nb);
+    DEB_RETURN() << DEB_VAR1(valid);
+    return valid;
+}
+
+// called with m_process_lock held
+bool Camera::_isFrameValid(long frame_nb) const
+{
+    long image_number = _getNbAcquiredFrames();
+    if(frame_nb < 0 || frame_nb >= image_number)
+      return false;
+    if(m_color_flag)
+    {
+	// the buffer may already hold a newer frame
+	const _ColorFrame& color_frame = m_color_frames[frame_nb % NB_COLOR_BUFFER];
+	return color_frame.ptr && color_frame.frame_nb == frame_nb &&
+	  m_color_buffer_frames[color_frame.buffer] == frame_nb &&
+	  !m_color_queued[color_frame.buffer];
+    }
+    int nb_buffers;
+    const_cast<_FrameBufferCtrlObj&>(m_buffer_ctrl_obj).getBuffer().getNbBuffers(nb_buffers);
+    if(frame_nb <= image_number - nb_buffers)
+      return false;
+    return _getStatus() == Camera::Ready ||
+      (m_nb_frames && frame_nb >= long(m_nb_frames) - nb_buffers);
+}
+
+//-----------------------------------------------------
+// Called by the acquisition thread with m_process_lock held, the
+// buffer of the new frame is kept out of the grab queue so it can
+// be pinned, the one of the previous frame is queued back.
+//-----------------------------------------------------
+void Camera::_holdColorFrame(const GrabResult& result,VideoMode mode)
+{
+    int buffer = 0;
+    while(buffer < NB_COLOR_BUFFER - 1 && m_color_buffer[buffer] != result.Buffer())
+      ++buffer;
+    m_color_queued[buffer] = false;
+    m_color_buffer_frames[buffer] = m_image_number;
+    int previous = m_color_last;
+    m_color_last = buffer;
+    if(previous >= 0 && previous != buffer && !m_color_pins[previous])
+      _queueColorBuffer(previous);
+
+    _ColorFrame& color_frame = m_color_frames[m_image_number % NB_COLOR_BUFFER];
+    color_frame.ptr = result.Buffer();
+    color_frame.width = result.GetSizeX();
+    color_frame.height = result.GetSizeY();
+    color_frame.mode = mode;
+    color_frame.frame_nb = m_image_number;
+    color_frame.buffer = buffer;
+}
+
+void Camera::_queueColorBuffer(int buffer)
+{
+    if(!StreamGrabber_ || m_color_queued[buffer])
+      return;
+    StreamGrabber_->QueueBuffer(m_color_handles[buffer],NULL);
+    m_color_queued[buffer] = true;
+}
+
+//-----------------------------------------------------
+// The acquisition thread broadcasts m_frame_cond on each new frame if
+// there are waiters and when it goes back to wait. m_acq_pending is
+// set by prepareAcq, so a wait started before startAcq doesn't return
+// at once, and cleared at the end of the acquisition (or by stopAcq
+// if it was never started).
+//-----------------------------------------------------
+bool Camera::waitFrame(long frame_nb,double timeout,long& last_frame)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR2(frame_nb,timeout);
+    Timestamp end = Timestamp::now() + timeout;
+    AutoMutex aLock(m_frame_cond.mutex());
+    atomicAdd(&m_nb_frame_waiters,1);
+    while(_getNbAcquiredFrames() <= frame_nb && m_acq_pending)
+      {
+	if(timeout < 0.)
+	  m_frame_cond.wait();
+	else
+	  {
+	    double remaining = end - Timestamp::now();
+	    if(remaining <= 0.)
+	      break;
+	    m_frame_cond.wait(remaining);
+	  }
+      }
+    atomicAdd(&m_nb_frame_waiters,(unsigned long long)-1);
+    long nb_frames = _getNbAcquiredFrames();
+    last_frame = nb_frames - 1;
+    bool acquired = nb_frames > frame_nb;
+    DEB_RETURN() << DEB_VAR2(acquired,last_frame);
+    return acquired;
+}
+
+bool Camera::waitAcqEnd(double timeout)
+{
+    DEB_MEMBER_FUNCT();
+    DEB_PARAM() << DEB_VAR1(timeout);
+    Timestamp end = Timestamp::now() + timeout;
+    AutoMutex aLock(m_frame_cond.mutex());
+    while(m_acq_pending)
+      {
+	if(timeout < 0.)
+	  m_frame_cond.wait();
+	else
+	  {
+	    double remaining = end - Timestamp::now();
+	    if(remaining <= 0.)
+	      break;
+	    m_frame_cond.wait(remaining);
+	  }
+      }
+    bool finished = !m_acq_pending;
+    DEB_RETURN() << DEB_VAR1(finished);
+    return finished;
+}
+
+void Camera::_setAcqPending(bool pending)
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_frame_cond.mutex());
+    m_acq_pending = pending;
+    m_frame_cond.broadcast();
+}
+
+void Camera::_checkNoPinnedFrame()
+{
+    DEB_MEMBER_FUNCT();
+    AutoMutex aLock(m_process_lock);
+    if(m_nb_pinned_frames)
+      THROW_HW_ERROR(Error) << m_nb_pinned_frames << " frame views are still alive";
+}
+
+//-----------------------------------------------------
+// Lima buffers are reallocated when their size or number change,
+// refused while views of the frames exist.
+//-----------------------------------------------------
+void Camera::_FrameBufferCtrlObj::setFrameDim(const FrameDim& frame_dim)
+{
+    FrameDim current;
+    getFrameDim(current);
+    if(frame_dim != current)
+      m_cam._checkNoPinnedFrame();
+    SoftBufferCtrlObj::setFrameDim(frame_dim);
+}
+
+void Camera::_FrameBufferCtrlObj::setNbBuffers(int nb_buffers)
+{
+    int current;
+    getNbBuffers(current);
+    if(nb_buffers != current)
+      m_cam._checkNoPinnedFrame();
+    SoftBufferCtrlObj::setNbBuffers(nb_buffers);
+}
+//---------------------------    
@@ -0,0 +1,387 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <string.h>
+#include <stdlib.h>
+#include "BaslerCompression.h"
+
+#ifdef BASLER_LZ4
+#include <lz4.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BASLER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Basler;
+
+//---------------------------
+// Bitshuffle, the n elements (n multiple of 8) are split in byte planes
+// then each byte plane in 8 bit planes of n / 8 bytes, bit j of byte i
+// of a bit plane comes from the element 8 * i + j (little endian only).
+//---------------------------
+
+// 8x8 bit matrix transpose, bit 8 * i + j <-> bit 8 * j + i
+static inline unsigned long long _transpose8(unsigned long long x)
+{
+  unsigned long long t;
+  t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+  x = x ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+  x = x ^ t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+  x = x ^ t ^ (t << 28);
+  return x;
+}
+
+static void _bitshuffle(const char* src,char* dst,char* tmp,int n,int depth)
+{
+  const unsigned char* in = (const unsigned char*)src;
+  unsigned char* planes = (unsigned char*)tmp;
+  unsigned char* out = (unsigned char*)dst;
+  if(depth > 1)
+    for(int i = 0;i < n;++i)
+      for(int b = 0;b < depth;++b)
+	planes[b * n + i] = in[i * depth + b];
+  else
+    planes = (unsigned char*)in;
+
+  int plane_size = n / 8;
+  for(int b = 0;b < depth;++b)
+    {
+      const unsigned char* p = planes + b * n;
+      unsigned char* o = out + b * n;
+      int i = 0;
+#ifdef BASLER_SSE2
+      for(;i + 16 <= n;i += 16)
+	{
+	  __m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+	  for(int k = 7;k >= 0;--k)
+	    {
+	      unsigned short bits = (unsigned short)_mm_movemask_epi8(x);
+	      memcpy(o + k * plane_size + i / 8,&bits,2);
+	      x = _mm_slli_epi16(x,1);
+	    }
+	}
+#endif
+      for(;i < n;i += 8)
+	{
+	  unsigned long long x;
+	  memcpy(&x,p + i,8);
+	  x = _transpose8(x);
+	  for(int k = 0;k < 8;++k)
+	    o[k * plane_size + i / 8] = (unsigned char)(x >> (8 * k));
+	}
+    }
+}
+
+static void _bitunshuffle(const char* src,char* dst,char* tmp,int n,int depth)
+{
+  const unsigned char* in = (const unsigned char*)src;
+  unsigned char* planes = depth > 1 ? (unsigned char*)tmp : (unsigned char*)dst;
+  int plane_size = n / 8;
+  for(int b = 0;b < depth;++b)
+    {
+      const unsigned char* p = in + b * n;
+      unsigned char* o = planes + b * n;
+      for(int i = 0;i < n;i += 8)
+	{
+	  unsigned long long x = 0;
+	  for(int k = 0;k < 8;++k)
+	    x |= (unsigned long long)p[k * plane_size + i / 8] << (8 * k);
+	  x = _transpose8(x);
+	  memcpy(o + i,&x,8);
+	}
+    }
+  if(depth > 1)
+    {
+      unsigned char* out = (unsigned char*)dst;
+      for(int i = 0;i < n;++i)
+	for(int b = 0;b < depth;++b)
+	  out[i * depth + b] = planes[b * n + i];
+    }
+}
+
+static inline int _compress_bound(int size)
+{
+#ifdef BASLER_LZ4
+  return LZ4_compressBound(size);
+#else
+  return size;
+#endif
+}
+
+//---------------------------
+// Compression of a range of blocks by a worker
+//---------------------------
+class CompressedRing::_CompressTask : public WorkerPool::Task
+{
+public:
+  _CompressTask(CompressedRing& ring,const char* frame) :
+    m_ring(ring),m_frame(frame) {}
+
+  virtual void process(int part,int nb_parts)
+  {
+    int nb_blocks = int(m_ring.m_header.nb_blocks);
+    m_ring._compressBlocks(m_frame,nb_blocks * part / nb_parts,
+			   nb_blocks * (part + 1) / nb_parts,part);
+  }
+
+private:
+  CompressedRing&	m_ring;
+  const char*		m_frame;
+};
+
+CompressedRing::CompressedRing() :
+  m_arena(NULL),
+  m_size(0),
+  m_head(0),
+  m_stored(0)
+{
+  memset(&m_header,0,sizeof(m_header));
+}
+
+CompressedRing::~CompressedRing()
+{
+  free(m_arena);
+}
+
+bool CompressedRing::isAvailable()
+{
+#ifdef BASLER_LZ4
+  return true;
+#else
+  return false;
+#endif
+}
+
+void CompressedRing::setSize(size_t size)
+{
+  _clear();
+  free(m_arena);
+  m_arena = NULL;
+  m_size = 0;
+  if(size)
+    {
+      m_arena = (char*)malloc(size);
+      if(m_arena)
+	m_size = size;
+    }
+}
+
+void CompressedRing::prepare(int width,int height,int depth)
+{
+  _clear();
+  m_header.width = width;
+  m_header.height = height;
+  m_header.depth = depth;
+  m_header.nb_blocks = (width * height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  m_block_sizes.resize(m_header.nb_blocks);
+}
+
+void CompressedRing::_clear()
+{
+  m_entries.clear();
+  m_head = 0;
+  m_stored = 0;
+}
+
+bool CompressedRing::add(long frame_nb,const void* frame,WorkerPool& pool)
+{
+  if(!m_arena || !m_header.nb_blocks)
+    return false;
+
+  int nb_parts = pool.getNbThreads();
+  if(nb_parts > int(m_header.nb_blocks))
+    nb_parts = int(m_header.nb_blocks);
+  m_scratch.resize(nb_parts);
+  m_part_sizes.resize(nb_parts);
+  _CompressTask task(*this,(const char*)frame);
+  if(nb_parts == pool.getNbThreads())
+    pool.run(task);
+  else
+    for(int part = 0;part < nb_parts;++part)
+      task.process(part,nb_parts);
+
+  size_t header_size = sizeof(Header) + m_header.nb_blocks * sizeof(unsigned int);
+  size_t size = header_size;
+  for(int part = 0;part < nb_parts;++part)
+    size += m_part_sizes[part];
+  if(size > m_size)
+    return false;
+
+  // oldest frames are at the head, the end of the arena is skipped on wrap
+  if(m_head + size > m_size)
+    {
+      while(!m_entries.empty() && m_entries.front().offset >= m_head)
+	{
+	  m_stored -= m_entries.front().size;
+	  m_entries.pop_front();
+	}
+      m_head = 0;
+    }
+  while(!m_entries.empty() && m_entries.front().offset >= m_head &&
+	m_entries.front().offset < m_head + size)
+    {
+      m_stored -= m_entries.front().size;
+      m_entries.pop_front();
+    }
+
+  char* p = m_arena + m_head;
+  memcpy(p,&m_header,sizeof(Header));
+  memcpy(p + sizeof(Header),&m_block_sizes[0],m_header.nb_blocks * sizeof(unsigned int));
+  p += header_size;
+  size_t tmp_size = 2 * BLOCK_SIZE * m_header.depth;
+  for(int part = 0;part < nb_parts;++part)
+    {
+      memcpy(p,&m_scratch[part][tmp_size],m_part_sizes[part]);
+      p += m_part_sizes[part];
+    }
+
+  Entry entry;
+  entry.frame_nb = frame_nb;
+  entry.offset = m_head;
+  entry.size = size;
+  m_entries.push_back(entry);
+  m_stored += size;
+  m_head += size;
+  return true;
+}
+
+//---------------------------
+// Each part has its own scratch, the shuffle buffers followed by
+// its compressed blocks.
+//---------------------------
+void CompressedRing::_compressBlocks(const char* frame,int first_block,int last_block,int part)
+{
+  int depth = int(m_header.depth);
+  int nb_pixels = int(m_header.width * m_header.height);
+  size_t tmp_size = 2 * BLOCK_SIZE * depth;
+  size_t needed = tmp_size + size_t(last_block - first_block) *
+    _compress_bound(BLOCK_SIZE * depth);
+  std::vector<char>& scratch = m_scratch[part];
+  if(scratch.size() < needed)
+    scratch.resize(needed);
+
+  char* shuffled = &scratch[0];
+  char* tmp = shuffled + BLOCK_SIZE * depth;
+  char* out = &scratch[tmp_size];
+  for(int block = first_block;block < last_block;++block)
+    {
+      int first = block * BLOCK_SIZE;
+      int n = nb_pixels - first < BLOCK_SIZE ? nb_pixels - first : BLOCK_SIZE;
+      int bytes = n * depth;
+      const char* in = frame + size_t(first) * depth;
+      if(!(n % 8))
+	{
+	  _bitshuffle(in,shuffled,tmp,n,depth);
+	  in = shuffled;
+	}
+      int compressed = 0;
+#ifdef BASLER_LZ4
+      compressed = LZ4_compress_default(in,out,bytes,_compress_bound(bytes));
+#endif
+      // incompressible blocks are stored as is
+      if(compressed <= 0 || compressed >= bytes)
+	{
+	  memcpy(out,in,bytes);
+	  compressed = bytes;
+	}
+      m_block_sizes[block] = compressed;
+      out += compressed;
+    }
+  m_part_sizes[part] = out - &scratch[tmp_size];
+}
+
+long CompressedRing::getFirstFrame() const
+{
+  return m_entries.empty() ? -1 : m_entries.front().frame_nb;
+}
+
+double CompressedRing::getRatio() const
+{
+  if(!m_stored)
+    return 0.;
+  double raw = double(m_header.width) * m_header.height * m_header.depth;
+  return raw * m_entries.size() / m_stored;
+}
+
+bool CompressedRing::get(long frame_nb,std::vector<char>& compressed) const
+{
+  if(m_entries.empty())
+    return false;
+  // frames are consecutive unless one didn't fit
+  long index = frame_nb - m_entries.front().frame_nb;
+  if(index < 0 || index >= long(m_entries.size()) ||
+     m_entries[index].frame_nb != frame_nb)
+    {
+      index = -1;
+      for(size_t i = 0;i < m_entries.size();++i)
+	if(m_entries[i].frame_nb == frame_nb)
+	  {
+	    index = long(i);
+	    break;
+	  }
+      if(index < 0)
+	return false;
+    }
+  const Entry& entry = m_entries[index];
+  compressed.assign(m_arena + entry.offset,m_arena + entry.offset + entry.size);
+  return true;
+}
+
+const CompressedRing::Header& CompressedRing::getHeader(const std::vector<char>& compressed)
+{
+  return *(const Header*)&compressed[0];
+}
+
+void CompressedRing::decompress(const std::vector<char>& compressed,void* dst)
+{
+  const Header& header = getHeader(compressed);
+  int depth = int(header.depth);
+  int nb_pixels = int(header.width * header.height);
+  const unsigned int* block_sizes = (const unsigned int*)(&compressed[0] + sizeof(Header));
+  const char* in = (const char*)(block_sizes + header.nb_blocks);
+  std::vector<char> shuffled(BLOCK_SIZE * depth);
+  std::vector<char> tmp(BLOCK_SIZE * depth);
+
+  for(unsigned int block = 0;block < header.nb_blocks;++block)
+    {
+      int first = block * BLOCK_SIZE;
+      int n = nb_pixels - first < BLOCK_SIZE ? nb_pixels - first : BLOCK_SIZE;
+      int bytes = n * depth;
+      char* out = (char*)dst + size_t(first) * depth;
+      bool shuffle = !(n % 8);
+      char* raw = shuffle ? &shuffled[0] : out;
+      int size = int(block_sizes[block]);
+      if(size == bytes)
+	memcpy(raw,in,bytes);
+#ifdef BASLER_LZ4
+      else
+	LZ4_decompress_safe(in,raw,size,bytes);
+#endif
+      if(shuffle)
+	_bitunshuffle(raw,out,&tmp[0],n,depth);
+      in += size;
+    }
+}
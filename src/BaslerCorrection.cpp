@@ -0,0 +1,240 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#include "BaslerCorrection.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BASLER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace lima;
+using namespace lima::Basler;
+
+// Values are clipped to [0,max_value] then rounded half up, the SSE2
+// path adds .5 and truncates so it gives the same result as the
+// scalar one (_mm_cvtps_epi32 would round half to even).
+static void _correct(const unsigned short* src,unsigned short* dst,
+		     const float* dark,const float* gain,int max_value,int begin,int end)
+{
+  int i = begin;
+  const float max_float = float(max_value);
+#ifdef BASLER_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bias = _mm_set1_epi32(32768);
+  const __m128i sign = _mm_set1_epi16(short(0x8000));
+  const __m128 min_value = _mm_setzero_ps();
+  const __m128 max_values = _mm_set1_ps(max_float);
+  const __m128 half = _mm_set1_ps(.5f);
+  for(;i + 8 <= end;i += 8)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v,zero));
+      __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v,zero));
+      lo = _mm_mul_ps(_mm_sub_ps(lo,_mm_loadu_ps(dark + i)),_mm_loadu_ps(gain + i));
+      hi = _mm_mul_ps(_mm_sub_ps(hi,_mm_loadu_ps(dark + i + 4)),_mm_loadu_ps(gain + i + 4));
+      lo = _mm_add_ps(_mm_min_ps(_mm_max_ps(lo,min_value),max_values),half);
+      hi = _mm_add_ps(_mm_min_ps(_mm_max_ps(hi,min_value),max_values),half);
+      // no unsigned saturating pack in SSE2, pack biased values then unbias
+      __m128i lo32 = _mm_sub_epi32(_mm_cvttps_epi32(lo),bias);
+      __m128i hi32 = _mm_sub_epi32(_mm_cvttps_epi32(hi),bias);
+      _mm_storeu_si128((__m128i*)(dst + i),_mm_xor_si128(_mm_packs_epi32(lo32,hi32),sign));
+    }
+#endif
+  for(;i < end;++i)
+    {
+      float value = (src[i] - dark[i]) * gain[i];
+      dst[i] = value <= 0.f ? 0 : value >= max_float ? (unsigned short)max_value :
+	(unsigned short)(value + .5f);
+    }
+}
+
+static void _correct(const unsigned char* src,unsigned char* dst,
+		     const float* dark,const float* gain,int max_value,int begin,int end)
+{
+  int i = begin;
+  const float max_float = float(max_value);
+#ifdef BASLER_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 min_value = _mm_setzero_ps();
+  const __m128 max_values = _mm_set1_ps(max_float);
+  const __m128 half = _mm_set1_ps(.5f);
+  for(;i + 16 <= end;i += 16)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128i v16[2] = {_mm_unpacklo_epi8(v,zero),_mm_unpackhi_epi8(v,zero)};
+      __m128i out16[2];
+      for(int j = 0;j < 2;++j)
+	{
+	  int k = i + j * 8;
+	  __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(v16[j],zero));
+	  __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(v16[j],zero));
+	  lo = _mm_mul_ps(_mm_sub_ps(lo,_mm_loadu_ps(dark + k)),_mm_loadu_ps(gain + k));
+	  hi = _mm_mul_ps(_mm_sub_ps(hi,_mm_loadu_ps(dark + k + 4)),_mm_loadu_ps(gain + k + 4));
+	  lo = _mm_add_ps(_mm_min_ps(_mm_max_ps(lo,min_value),max_values),half);
+	  hi = _mm_add_ps(_mm_min_ps(_mm_max_ps(hi,min_value),max_values),half);
+	  out16[j] = _mm_packs_epi32(_mm_cvttps_epi32(lo),_mm_cvttps_epi32(hi));
+	}
+      _mm_storeu_si128((__m128i*)(dst + i),_mm_packus_epi16(out16[0],out16[1]));
+    }
+#endif
+  for(;i < end;++i)
+    {
+      float value = (src[i] - dark[i]) * gain[i];
+      dst[i] = value <= 0.f ? 0 : value >= max_float ? (unsigned char)max_value :
+	(unsigned char)(value + .5f);
+    }
+}
+
+template<class T>
+static void _replace_defects(T* dst,const std::vector<int>& defects,
+			     const std::vector<int>& first_neighbour,
+			     const std::vector<int>& neighbours)
+{
+  for(size_t i = 0;i < defects.size();++i)
+    {
+      int first = first_neighbour[i],last = first_neighbour[i + 1];
+      if(first == last) continue;
+      unsigned int sum = 0;
+      for(int j = first;j < last;++j)
+	sum += dst[neighbours[j]];
+      int nb = last - first;
+      dst[defects[i]] = T((sum + nb / 2) / nb);
+    }
+}
+
+Correction::Correction() :
+  m_width(0),
+  m_height(0),
+  m_has_dark(false),
+  m_has_flat(false)
+{
+  m_first_neighbour.push_back(0);
+}
+
+void Correction::setSize(int width,int height)
+{
+  if(width == m_width && height == m_height) return;
+  m_width = width;
+  m_height = height;
+  clear();
+}
+
+void Correction::clear()
+{
+  m_has_dark = m_has_flat = false;
+  m_defects.clear();
+  m_neighbours.clear();
+  m_first_neighbour.assign(1,0);
+  _resetTables();
+}
+
+void Correction::_resetTables()
+{
+  if(!m_has_dark) m_dark.assign(getNbPixels(),0.f);
+  if(!m_has_flat) m_gain.assign(getNbPixels(),1.f);
+}
+
+void Correction::setDark(const std::vector<float>& dark)
+{
+  m_has_dark = !dark.empty();
+  if(m_has_dark) m_dark = dark;
+  _resetTables();
+}
+
+void Correction::setFlat(const std::vector<float>& flat)
+{
+  m_has_flat = !flat.empty();
+  if(m_has_flat)
+    {
+      double sum = 0.;
+      long nb = 0;
+      for(size_t i = 0;i < flat.size();++i)
+	if(flat[i] > 0.f)
+	  sum += flat[i],++nb;
+      float mean = nb ? float(sum / nb) : 1.f;
+      // dead pixels of the flat are left as is
+      m_gain.resize(flat.size());
+      for(size_t i = 0;i < flat.size();++i)
+	m_gain[i] = flat[i] > 0.f ? mean / flat[i] : 1.f;
+    }
+  _resetTables();
+}
+
+void Correction::setDefects(const std::vector<unsigned char>& defects)
+{
+  m_defects.clear();
+  m_neighbours.clear();
+  m_first_neighbour.assign(1,0);
+  if(defects.empty()) return;
+
+  for(int y = 0;y < m_height;++y)
+    for(int x = 0;x < m_width;++x)
+      {
+	int index = y * m_width + x;
+	if(!defects[index]) continue;
+	m_defects.push_back(index);
+	for(int dy = -1;dy <= 1;++dy)
+	  for(int dx = -1;dx <= 1;++dx)
+	    {
+	      int nx = x + dx,ny = y + dy;
+	      if((!dx && !dy) || nx < 0 || ny < 0 || nx >= m_width || ny >= m_height)
+		continue;
+	      int neighbour = ny * m_width + nx;
+	      if(!defects[neighbour])
+		m_neighbours.push_back(neighbour);
+	    }
+	m_first_neighbour.push_back(int(m_neighbours.size()));
+      }
+}
+
+void Correction::swap(Correction& other)
+{
+  std::swap(m_width,other.m_width);
+  std::swap(m_height,other.m_height);
+  std::swap(m_has_dark,other.m_has_dark);
+  std::swap(m_has_flat,other.m_has_flat);
+  m_dark.swap(other.m_dark);
+  m_gain.swap(other.m_gain);
+  m_defects.swap(other.m_defects);
+  m_first_neighbour.swap(other.m_first_neighbour);
+  m_neighbours.swap(other.m_neighbours);
+}
+
+void Correction::correct(const void* src,void* dst,int depth,int max_value,
+			 int begin,int end) const
+{
+  if(depth == 1)
+    _correct((const unsigned char*)src,(unsigned char*)dst,&m_dark[0],&m_gain[0],
+	     max_value,begin,end);
+  else
+    _correct((const unsigned short*)src,(unsigned short*)dst,&m_dark[0],&m_gain[0],
+	     max_value,begin,end);
+}
+
+void Correction::replaceDefects(void* dst,int depth) const
+{
+  if(depth == 1)
+    _replace_defects((unsigned char*)dst,m_defects,m_first_neighbour,m_neighbours);
+  else
+    _replace_defects((unsigned short*)dst,m_defects,m_first_neighbour,m_neighbours);
+}
@@ -77,10 +77,10 @@ void DetInfoCtrlObj::getDetectorModel(std::string& det_model)
 
 void DetInfoCtrlObj::registerMaxImageSizeCallback(HwMaxImageSizeCallback& cb)
 {
-    //m_cam.registerMaxImageSizeCallback(cb);
+    m_cam.registerMaxImageSizeCallback(cb);
 }
 
 void DetInfoCtrlObj::unregisterMaxImageSizeCallback(HwMaxImageSizeCallback& cb)
 {
-    //m_cam.unregisterMaxImageSizeCallback(cb);
+    m_cam.unregisterMaxImageSizeCallback(cb);
 }
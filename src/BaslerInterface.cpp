@@ -35,6 +35,9 @@ Interface::Interface(Camera& cam) :
   m_cam(cam)
 {
   DEB_CONSTRUCTOR();
+  // the camera may have been created with lazy_open
+  m_cam.waitOpened();
+  m_cam.m_interface_created = true;
   m_det_info = new DetInfoCtrlObj(cam);
   m_sync = new SyncCtrlObj(cam);
   m_roi = new RoiCtrlObj(cam);
@@ -88,7 +91,10 @@ void Interface::reset(ResetLevel reset_level)
 
   stopAcq();
 
-  m_cam._setStatus(Camera::Ready,true);
+  // a lost camera stays in Fault until reconnected
+  AutoMutex aDeviceLock(m_cam.m_device_lock);
+  if(m_cam.Camera_)
+    m_cam._setStatus(Camera::Ready,true);
 }
 
 void Interface::prepareAcq()
@@ -0,0 +1,123 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <string.h>
+#include "BaslerLatencyHistogram.h"
+
+using namespace lima;
+using namespace lima::Basler;
+
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+void LatencyHistogram::reset()
+{
+  memset(m_buckets,0,sizeof(m_buckets));
+  m_count = 0;
+  m_min = 0;
+  m_max = 0;
+  m_sum = 0.;
+}
+
+int LatencyHistogram::_getBucket(unsigned long long value)
+{
+  if(value < NB_SUB_BUCKETS)
+    return int(value);
+
+  int magnitude = 0;
+  while(value >= (2ULL << NB_SUB_BUCKETS_BITS))
+    {
+      value >>= 1;
+      ++magnitude;
+    }
+  // value is now in [NB_SUB_BUCKETS,2*NB_SUB_BUCKETS[
+  int bucket = (magnitude + 1) * NB_SUB_BUCKETS + int(value) - NB_SUB_BUCKETS;
+  return bucket < NB_BUCKETS ? bucket : NB_BUCKETS - 1;
+}
+
+double LatencyHistogram::getBucketValue(int bucket)
+{
+  int magnitude = bucket / NB_SUB_BUCKETS;
+  int sub_bucket = bucket % NB_SUB_BUCKETS;
+  unsigned long long value;
+  if(!magnitude)
+    value = sub_bucket;
+  else
+    value = (unsigned long long)(NB_SUB_BUCKETS + sub_bucket) << (magnitude - 1);
+  return value * 1e-6;
+}
+
+void LatencyHistogram::record(double latency)
+{
+  unsigned long long value = latency > 0. ? (unsigned long long)(latency * 1e6) : 0;
+  ++m_buckets[_getBucket(value)];
+  if(!m_count || value < m_min) m_min = value;
+  if(value > m_max) m_max = value;
+  m_sum += value;
+  ++m_count;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+  if(!other.m_count) return;
+  for(int bucket = 0;bucket < NB_BUCKETS;++bucket)
+    m_buckets[bucket] += other.m_buckets[bucket];
+  if(!m_count || other.m_min < m_min) m_min = other.m_min;
+  if(other.m_max > m_max) m_max = other.m_max;
+  m_sum += other.m_sum;
+  m_count += other.m_count;
+}
+
+double LatencyHistogram::getMin() const
+{
+  return m_min * 1e-6;
+}
+
+double LatencyHistogram::getMax() const
+{
+  return m_max * 1e-6;
+}
+
+double LatencyHistogram::getMean() const
+{
+  return m_count ? m_sum / m_count * 1e-6 : 0.;
+}
+
+double LatencyHistogram::getPercentile(double percentile) const
+{
+  if(!m_count) return 0.;
+
+  double threshold = m_count * percentile / 100.;
+  long cumul = 0;
+  for(int bucket = 0;bucket < NB_BUCKETS;++bucket)
+    {
+      cumul += m_buckets[bucket];
+      if(cumul && cumul >= threshold)
+	{
+	  // middle of the bucket
+	  double value = (getBucketValue(bucket) + getBucketValue(bucket + 1)) / 2.;
+	  return value < getMax() ? value : getMax();
+	}
+    }
+  return getMax();
+}
@@ -0,0 +1,181 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <algorithm>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/eventfd.h>
+#endif
+#include "BaslerNotifier.h"
+
+using namespace lima;
+using namespace lima::Basler;
+
+class Notifier::_Thread : public Thread
+{
+  DEB_CLASS_NAMESPC(DebModCamera, "Notifier", "_Thread");
+public:
+  _Thread(Notifier& notifier) : m_notifier(notifier) {}
+  virtual ~_Thread() {join();}
+
+protected:
+  virtual void threadFunction();
+
+private:
+  Notifier&	m_notifier;
+};
+
+void Notifier::_Thread::threadFunction()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex aLock(m_notifier.m_cond.mutex());
+  while(!m_notifier.m_quit)
+    {
+      if(!atomicLoad(&m_notifier.m_cb_pending))
+	{
+	  m_notifier.m_cond.wait();
+	  continue;
+	}
+      // the callback lock is taken before m_cond is released so an
+      // unregistered callback is never called once unregister returned
+      AutoMutex cbLock(m_notifier.m_callback_lock);
+      std::vector<NotifyCallback*> callbacks = m_notifier.m_callbacks;
+      aLock.unlock();
+
+      int events = int(atomicExchange(&m_notifier.m_cb_pending,0));
+      for(std::vector<NotifyCallback*>::iterator i = callbacks.begin();
+	  i != callbacks.end();++i)
+	{
+	  try
+	    {
+	      (*i)->notify(events);
+	    }
+	  catch(...)
+	    {
+	      DEB_ERROR() << "Exception in notify callback";
+	    }
+	}
+      cbLock.unlock();
+      aLock.lock();
+    }
+}
+
+Notifier::Notifier() :
+  m_fd(-1),
+  m_fd_pending(0),
+  m_cb_pending(0),
+  m_has_callbacks(false),
+  m_quit(false),
+  m_thread(NULL)
+{
+  DEB_CONSTRUCTOR();
+#ifdef __linux__
+  m_fd = eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC);
+  if(m_fd < 0)
+    DEB_WARNING() << "Can't create the notification eventfd";
+#endif
+}
+
+Notifier::~Notifier()
+{
+  DEB_DESTRUCTOR();
+  if(m_thread)
+    {
+      AutoMutex aLock(m_cond.mutex());
+      m_quit = true;
+      m_cond.broadcast();
+      aLock.unlock();
+      delete m_thread;
+    }
+#ifdef __linux__
+  if(m_fd >= 0)
+    ::close(m_fd);
+#endif
+}
+
+//-----------------------------------------------------
+// Called by the acquisition thread, only the first event
+// after a consumption costs a system call.
+//-----------------------------------------------------
+void Notifier::post(int events)
+{
+#ifdef __linux__
+  if(m_fd >= 0 && !atomicOr(&m_fd_pending,events))
+    {
+      eventfd_t one = 1;
+      if(::write(m_fd,&one,sizeof(one)) < 0)
+	atomicExchange(&m_fd_pending,0);	// can't fail unless overflow
+    }
+#endif
+  if(m_has_callbacks && !atomicOr(&m_cb_pending,events))
+    {
+      AutoMutex aLock(m_cond.mutex());
+      m_cond.broadcast();
+    }
+}
+
+//-----------------------------------------------------
+// The eventfd is cleared before the pending events are taken,
+// so events posted meanwhile either are returned now or
+// signal the eventfd again.
+//-----------------------------------------------------
+int Notifier::readEvents()
+{
+#ifdef __linux__
+  if(m_fd >= 0)
+    {
+      eventfd_t value;
+      if(::read(m_fd,&value,sizeof(value)) < 0)
+	value = 0;		// EAGAIN, nothing posted
+    }
+#endif
+  return int(atomicExchange(&m_fd_pending,0));
+}
+
+void Notifier::registerCallback(NotifyCallback& cb)
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex aLock(m_cond.mutex());
+  if(std::find(m_callbacks.begin(),m_callbacks.end(),&cb) != m_callbacks.end())
+    THROW_HW_ERROR(InvalidValue) << "Callback already registered";
+  m_callbacks.push_back(&cb);
+  if(!m_thread)
+    {
+      m_thread = new _Thread(*this);
+      m_thread->start();
+    }
+  m_has_callbacks = true;
+}
+
+void Notifier::unregisterCallback(NotifyCallback& cb)
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex aLock(m_cond.mutex());
+  std::vector<NotifyCallback*>::iterator i =
+    std::find(m_callbacks.begin(),m_callbacks.end(),&cb);
+  if(i == m_callbacks.end())
+    THROW_HW_ERROR(InvalidValue) << "Callback not registered";
+  m_callbacks.erase(i);
+  m_has_callbacks = !m_callbacks.empty();
+  aLock.unlock();
+  // wait for a notification in progress
+  AutoMutex cbLock(m_callback_lock);
+}
@@ -0,0 +1,131 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <string.h>
+#include <algorithm>
+#include "BaslerPreview.h"
+
+using namespace lima;
+using namespace lima::Basler;
+
+Preview::Preview() :
+  m_interval(0.),
+  m_factor(1),
+  m_next_time(0.),
+  m_has_frame(false)
+{
+}
+
+void Preview::setInterval(double interval)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(interval);
+  if(interval < 0.)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(interval);
+  m_interval = interval;
+  m_next_time = 0.;
+}
+
+void Preview::setDownsampling(int factor)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(factor);
+  if(factor < 1)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(factor);
+  m_factor = factor;
+}
+
+void Preview::reset()
+{
+  AutoMutex aLock(m_lock);
+  m_has_frame = false;
+  m_next_time = 0.;
+}
+
+template<class T>
+void Preview::_subsample(const T* src,T* dst,int width,int height,
+			 int channels,int factor)
+{
+  int out_width = width / factor;
+  int out_height = height / factor;
+  int src_step = factor * channels;
+  for(int y = 0;y < out_height;++y)
+    {
+      const T* src_line = src + size_t(y) * factor * width * channels;
+      for(int x = 0;x < out_width;++x,src_line += src_step)
+	for(int c = 0;c < channels;++c)
+	  *dst++ = src_line[c];
+    }
+}
+
+//-----------------------------------------------------
+// Called by the acquisition thread, time is the host time
+// of the interval check, timestamp the frame one.
+//-----------------------------------------------------
+void Preview::update(const void* frame,int width,int height,int depth,int channels,
+		     long frame_nb,double time,double timestamp)
+{
+  int factor = m_factor;
+  if(factor > width || factor > height)
+    factor = 1;
+  m_next_time = time + m_interval;
+
+  m_back.width = width / factor;
+  m_back.height = height / factor;
+  m_back.depth = depth;
+  m_back.channels = channels;
+  m_back.frame_nb = frame_nb;
+  m_back.timestamp = timestamp;
+  size_t size = size_t(m_back.width) * m_back.height * depth * channels;
+  if(m_back.data.size() != size)
+    m_back.data.resize(size);
+
+  if(factor == 1)
+    memcpy(&m_back.data[0],frame,size);
+  else if(depth == 1)
+    _subsample((const unsigned char*)frame,(unsigned char*)&m_back.data[0],
+	       width,height,channels,factor);
+  else if(depth == 2)
+    _subsample((const unsigned short*)frame,(unsigned short*)&m_back.data[0],
+	       width,height,channels,factor);
+  else
+    _subsample((const unsigned int*)frame,(unsigned int*)&m_back.data[0],
+	       width,height,channels,factor);
+
+  // swap without copying the data
+  AutoMutex aLock(m_lock);
+  m_front.data.swap(m_back.data);
+  std::swap(m_front.width,m_back.width);
+  std::swap(m_front.height,m_back.height);
+  std::swap(m_front.depth,m_back.depth);
+  std::swap(m_front.channels,m_back.channels);
+  std::swap(m_front.frame_nb,m_back.frame_nb);
+  std::swap(m_front.timestamp,m_back.timestamp);
+  m_has_frame = true;
+}
+
+bool Preview::getLast(Frame& frame) const
+{
+  AutoMutex aLock(m_lock);
+  if(m_has_frame)
+    frame = m_front;
+  return m_has_frame;
+}
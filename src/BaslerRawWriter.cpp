@@ -0,0 +1,377 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#ifdef __unix
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#endif
+#include "BaslerRawWriter.h"
+#include "lima/Timestamp.h"
+
+using namespace lima;
+using namespace lima::Basler;
+
+class RawWriter::_WriterThread : public Thread
+{
+  DEB_CLASS_NAMESPC(DebModCamera, "RawWriter", "_WriterThread");
+public:
+  _WriterThread(RawWriter& writer) : m_writer(writer) {}
+  virtual ~_WriterThread() {join();}
+
+protected:
+  virtual void threadFunction() {m_writer._run();}
+
+private:
+  RawWriter&	m_writer;
+};
+
+RawWriter::RawWriter() :
+  m_callback(NULL),
+  m_thread(NULL),
+  m_fd(-1),
+  m_index_fd(-1),
+  m_nb_written(0),
+  m_start_time(0.),
+  m_last_time(0.),
+  m_max_queue_depth(0),
+  m_closing(false)
+{
+  memset(&m_header,0,sizeof(m_header));
+}
+
+RawWriter::~RawWriter()
+{
+  try
+    {
+      close();
+    }
+  catch(...)
+    {
+    }
+}
+
+size_t RawWriter::getStride(size_t frame_size)
+{
+  return (frame_size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+void RawWriter::open(const std::string& filename,int width,int height,int depth,
+		     size_t frame_size)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR5(filename,width,height,depth,frame_size);
+  close();
+#ifdef __unix
+  // O_DIRECT is refused by some filesystems (tmpfs), fall back to the page cache
+  m_fd = ::open(filename.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT,0644);
+  if(m_fd < 0 && errno == EINVAL)
+    {
+      DEB_WARNING() << "O_DIRECT not supported for " << filename;
+      m_fd = ::open(filename.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+    }
+  if(m_fd < 0)
+    THROW_HW_ERROR(Error) << "Can't open " << filename << ": " << strerror(errno);
+  std::string index_filename = filename + ".idx";
+  m_index_fd = ::open(index_filename.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+  if(m_index_fd < 0)
+    {
+      int error = errno;
+      ::close(m_fd);
+      m_fd = -1;
+      THROW_HW_ERROR(Error) << "Can't open " << index_filename << ": " << strerror(error);
+    }
+#else
+  THROW_HW_ERROR(NotSupported) << "Raw streaming is only available on unix";
+#endif
+
+  m_filename = filename;
+  memset(&m_header,0,sizeof(m_header));
+  memcpy(m_header.magic,"LIMARAW1",8);
+  m_header.width = width;
+  m_header.height = height;
+  m_header.depth = depth;
+  m_header.frame_size = frame_size;
+  m_header.stride = getStride(frame_size);
+  m_header.data_offset = getStride(sizeof(FileHeader));
+
+  m_queue.clear();
+  m_written.clear();
+  m_nb_written = 0;
+  m_start_time = m_last_time = 0.;
+  m_max_queue_depth = 0;
+  m_error.clear();
+  m_closing = false;
+  m_thread = new _WriterThread(*this);
+  m_thread->start();
+}
+
+void RawWriter::write(const void* buffer,void* context,const FrameInfo& info)
+{
+  AutoMutex aLock(m_cond.mutex());
+  _Frame frame;
+  frame.buffer = buffer;
+  frame.context = context;
+  frame.info = info;
+  m_queue.push_back(frame);
+  if(int(m_queue.size()) > m_max_queue_depth)
+    m_max_queue_depth = int(m_queue.size());
+  m_cond.broadcast();
+}
+
+void RawWriter::getWritten(std::vector<void*>& contexts)
+{
+  AutoMutex aLock(m_cond.mutex());
+  contexts.swap(m_written);
+  m_written.clear();
+}
+
+bool RawWriter::getError(std::string& error)
+{
+  AutoMutex aLock(m_cond.mutex());
+  error = m_error;
+  return !m_error.empty();
+}
+
+void RawWriter::close()
+{
+  DEB_MEMBER_FUNCT();
+  if(m_fd < 0) return;
+
+  AutoMutex aLock(m_cond.mutex());
+  m_closing = true;
+  m_cond.broadcast();
+  aLock.unlock();
+  delete m_thread;
+  m_thread = NULL;
+
+  _writeIndex();
+#ifdef __unix
+  ::close(m_fd);
+  ::close(m_index_fd);
+#endif
+  m_fd = m_index_fd = -1;
+  DEB_TRACE() << m_nb_written << " frames written in " << m_filename;
+}
+
+void RawWriter::getStatistics(Statistics& stats)
+{
+  AutoMutex aLock(m_cond.mutex());
+  stats.nb_frames = long(m_nb_written);
+  stats.nb_bytes = double(m_nb_written) * double(m_header.stride);
+  double elapsed = m_last_time - m_start_time;
+  stats.throughput = elapsed > 0. ? stats.nb_bytes / elapsed / (1024. * 1024.) : 0.;
+  stats.queue_depth = int(m_queue.size());
+  stats.max_queue_depth = m_max_queue_depth;
+}
+
+//---------------------------
+// Frames stay in the queue while written, so the queue depth
+// includes the batch in progress.
+//---------------------------
+void RawWriter::_run()
+{
+  AutoMutex aLock(m_cond.mutex());
+  while(true)
+    {
+      while(m_queue.empty() && !m_closing)
+	m_cond.wait();
+      if(m_queue.empty())
+	break;
+
+      int nb_frames = int(m_queue.size()) < MAX_BATCH ? int(m_queue.size()) : MAX_BATCH;
+      unsigned long long first_frame = m_nb_written;
+      unsigned long long offset = m_header.data_offset + first_frame * m_header.stride;
+      FrameInfo infos[MAX_BATCH];
+      for(int i = 0;i < nb_frames;++i)
+	infos[i] = m_queue[i].info;
+      bool ok = m_error.empty();
+      if(!m_start_time)
+	m_start_time = Timestamp::now();
+      aLock.unlock();
+
+      int error = 0;
+      if(ok && (!_writeBatch(nb_frames,offset) ||
+		!_appendIndex(infos,nb_frames,first_frame)))
+	{
+	  ok = false;
+	  error = errno;
+	}
+
+      aLock.lock();
+      for(int i = 0;i < nb_frames;++i)
+	{
+	  m_written.push_back(m_queue.front().context);
+	  m_queue.pop_front();
+	}
+      // after an error the buffers are only given back
+      if(ok)
+	{
+	  m_nb_written += nb_frames;
+	  m_last_time = Timestamp::now();
+	}
+      else if(error)
+	m_error = "Write error on " + m_filename + ": " + strerror(error);
+      Callback* callback = m_callback;
+      aLock.unlock();
+      if(callback)
+	callback->framesWritten();
+      aLock.lock();
+    }
+}
+
+bool RawWriter::_writeBatch(int nb_frames,unsigned long long offset)
+{
+#ifdef __unix
+  struct iovec iov[MAX_BATCH];
+  for(int i = 0;i < nb_frames;++i)
+    {
+      iov[i].iov_base = const_cast<void*>(m_queue[i].buffer);
+      iov[i].iov_len = m_header.stride;
+    }
+  struct iovec* first = iov;
+  int nb_iov = nb_frames;
+  size_t remaining = size_t(nb_frames) * m_header.stride;
+  while(nb_iov)
+    {
+      ssize_t written = pwritev(m_fd,first,nb_iov,off_t(offset));
+      if(written < 0)
+	{
+	  if(errno == EINTR) continue;
+	  return false;
+	}
+      if(!written)
+	{
+	  errno = EIO;
+	  return false;
+	}
+      size_t done = size_t(written);
+      if(done < remaining)
+	{
+	  // O_DIRECT needs aligned offsets and buffers, a partial write is
+	  // resumed from its last aligned boundary. Without a whole block
+	  // written, O_DIRECT is dropped for the rest of the file.
+	  int flags = fcntl(m_fd,F_GETFL);
+	  if(flags >= 0 && (flags & O_DIRECT))
+	    {
+	      if(done >= ALIGNMENT)
+		done -= done % ALIGNMENT;
+	      else if(fcntl(m_fd,F_SETFL,flags & ~O_DIRECT) < 0)
+		return false;
+	    }
+	}
+      offset += done;
+      remaining -= done;
+      // partial write, skip what's done
+      while(nb_iov && done >= first->iov_len)
+	{
+	  done -= first->iov_len;
+	  ++first,--nb_iov;
+	}
+      if(nb_iov)
+	{
+	  first->iov_base = (char*)first->iov_base + done;
+	  first->iov_len -= done;
+	}
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+//---------------------------
+// Called by the writer thread once the frames are written,
+// the .idx file is written through the page cache.
+//---------------------------
+bool RawWriter::_appendIndex(const FrameInfo* infos,int nb_frames,
+			     unsigned long long first_frame)
+{
+#ifdef __unix
+  const char* data = (const char*)infos;
+  size_t size = size_t(nb_frames) * sizeof(FrameInfo);
+  off_t offset = off_t(first_frame * sizeof(FrameInfo));
+  while(size)
+    {
+      ssize_t written = pwrite(m_index_fd,data,size,offset);
+      if(written < 0)
+	{
+	  if(errno == EINTR) continue;
+	  return false;
+	}
+      data += written,size -= written,offset += written;
+    }
+  return true;
+#else
+  return false;
+#endif
+}
+
+//---------------------------
+// The frame table is copied from the .idx file, it and the header
+// go through an aligned buffer, as required by O_DIRECT. The .idx
+// file is only removed once the table is in the raw file.
+//---------------------------
+void RawWriter::_writeIndex()
+{
+  DEB_MEMBER_FUNCT();
+#ifdef __unix
+  m_header.nb_frames = m_nb_written;
+  m_header.index_offset = m_header.data_offset + m_nb_written * m_header.stride;
+  std::string index_filename = m_filename + ".idx";
+  int index_fd = ::open(index_filename.c_str(),O_RDONLY);
+  if(index_fd < 0)
+    {
+      DEB_ERROR() << "Can't read " << index_filename << ": " << strerror(errno);
+      return;
+    }
+  const size_t chunk_size = 256 * ALIGNMENT;	// a multiple of sizeof(FrameInfo)
+  void* buffer;
+  if(posix_memalign(&buffer,ALIGNMENT,chunk_size))
+    {
+      DEB_ERROR() << "Can't allocate the frame table of " << m_filename;
+      ::close(index_fd);
+      return;
+    }
+  size_t index_size = size_t(m_nb_written) * sizeof(FrameInfo);
+  bool ok = true;
+  for(size_t pos = 0;ok && pos < index_size;pos += chunk_size)
+    {
+      size_t size = index_size - pos < chunk_size ? index_size - pos : chunk_size;
+      memset(buffer,0,chunk_size);
+      ok = pread(index_fd,buffer,size,off_t(pos)) == ssize_t(size) &&
+	pwrite(m_fd,buffer,getStride(size),off_t(m_header.index_offset + pos)) >= 0;
+    }
+  ::close(index_fd);
+  memset(buffer,0,chunk_size);
+  memcpy(buffer,&m_header,sizeof(FileHeader));
+  ok = pwrite(m_fd,buffer,getStride(sizeof(FileHeader)),0) >= 0 && ok;
+  free(buffer);
+  if(!ok)
+    DEB_ERROR() << "Can't write the frame table of " << m_filename << ": " << strerror(errno);
+  else
+    unlink(index_filename.c_str());
+#endif
+}
@@ -0,0 +1,242 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include <string.h>
+#include <errno.h>
+#ifdef __unix
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "BaslerShmRing.h"
+
+using namespace lima;
+using namespace lima::Basler;
+
+static inline unsigned long long _align(unsigned long long size)
+{
+  return (size + ShmRing::ALIGNMENT - 1) / ShmRing::ALIGNMENT * ShmRing::ALIGNMENT;
+}
+
+ShmRing::ShmRing() :
+  m_header(NULL),
+  m_size(0)
+{
+}
+
+ShmRing::~ShmRing()
+{
+  close();
+}
+
+void ShmRing::create(const std::string& name,int width,int height,int depth,int nb_slots)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR5(name,width,height,depth,nb_slots);
+  close();
+#ifdef __unix
+  unsigned long long frame_size = (unsigned long long)width * height * depth;
+  unsigned long long slot_size = _align(frame_size);
+  unsigned long long slots_offset = _align(sizeof(Header));
+  unsigned long long data_offset = slots_offset + _align(nb_slots * sizeof(Slot));
+  size_t size = size_t(data_offset + nb_slots * slot_size);
+
+  // a previous segment may still be mapped by readers, they keep it
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(),O_RDWR | O_CREAT | O_EXCL,0644);
+  if(fd < 0)
+    THROW_HW_ERROR(Error) << "Can't create shared memory " << name << ": " << strerror(errno);
+  if(ftruncate(fd,off_t(size)))
+    {
+      int error = errno;
+      ::close(fd);
+      shm_unlink(name.c_str());
+      THROW_HW_ERROR(Error) << "Can't size shared memory " << name << ": " << strerror(error);
+    }
+  void* ptr = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+  ::close(fd);
+  if(ptr == MAP_FAILED)
+    {
+      shm_unlink(name.c_str());
+      THROW_HW_ERROR(Error) << "Can't map shared memory " << name << ": " << strerror(errno);
+    }
+
+  // new pages are zeroed, magic is written last so readers see a complete header
+  m_header = (Header*)ptr;
+  m_size = size;
+  m_name = name;
+  m_header->width = width;
+  m_header->height = height;
+  m_header->depth = depth;
+  m_header->nb_slots = nb_slots;
+  m_header->frame_size = frame_size;
+  m_header->slot_size = slot_size;
+  m_header->slots_offset = slots_offset;
+  m_header->data_offset = data_offset;
+  atomicStore(&m_header->write_count,0);
+  memcpy(m_header->magic,"LIMASHM1",8);
+#else
+  THROW_HW_ERROR(NotSupported) << "Shared memory ring is only available on unix";
+#endif
+}
+
+void ShmRing::close()
+{
+  if(!m_header) return;
+#ifdef __unix
+  atomicStore(&m_header->closed,1);
+  munmap(m_header,m_size);
+  shm_unlink(m_name.c_str());
+#endif
+  m_header = NULL;
+  m_size = 0;
+}
+
+void ShmRing::publish(const void* frame,long long frame_nb,double timestamp,
+		      unsigned long long camera_timestamp)
+{
+  unsigned long long n = atomicLoad(&m_header->write_count);
+  unsigned int index = (unsigned int)(n % m_header->nb_slots);
+  Slot* slot = (Slot*)((char*)m_header + m_header->slots_offset) + index;
+  char* data = (char*)m_header + m_header->data_offset + index * m_header->slot_size;
+
+  atomicStore(&slot->sequence,2 * n + 1);
+  atomicWriteFence();
+  memcpy(data,frame,size_t(m_header->frame_size));
+  slot->frame_nb = frame_nb;
+  slot->timestamp = timestamp;
+  slot->camera_timestamp = camera_timestamp;
+  atomicStore(&slot->sequence,2 * n + 2);
+  atomicStore(&m_header->write_count,n + 1);
+}
+
+unsigned long long ShmRing::getNbPublished() const
+{
+  return m_header ? atomicLoad(&m_header->write_count) : 0;
+}
+
+//---------------------------
+// Reader
+//---------------------------
+ShmRing::Reader::Reader() :
+  m_header(NULL),
+  m_size(0),
+  m_next(0),
+  m_slot(NULL),
+  m_sequence(0),
+  m_nb_overruns(0)
+{
+}
+
+ShmRing::Reader::~Reader()
+{
+  close();
+}
+
+void ShmRing::Reader::open(const std::string& name)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(name);
+  close();
+#ifdef __unix
+  int fd = shm_open(name.c_str(),O_RDONLY,0);
+  if(fd < 0)
+    THROW_HW_ERROR(Error) << "Can't open shared memory " << name << ": " << strerror(errno);
+  struct stat st;
+  void* ptr = MAP_FAILED;
+  if(!fstat(fd,&st) && size_t(st.st_size) >= sizeof(Header))
+    ptr = mmap(NULL,size_t(st.st_size),PROT_READ,MAP_SHARED,fd,0);
+  ::close(fd);
+  if(ptr == MAP_FAILED)
+    THROW_HW_ERROR(Error) << "Can't map shared memory " << name;
+
+  Header* header = (Header*)ptr;
+  if(memcmp(header->magic,"LIMASHM1",8))
+    {
+      munmap(ptr,size_t(st.st_size));
+      THROW_HW_ERROR(Error) << "Shared memory " << name << " is not a frame ring";
+    }
+  m_header = header;
+  m_size = size_t(st.st_size);
+  m_next = atomicLoad(&m_header->write_count);
+  m_slot = NULL;
+  m_nb_overruns = 0;
+#else
+  THROW_HW_ERROR(NotSupported) << "Shared memory ring is only available on unix";
+#endif
+}
+
+void ShmRing::Reader::close()
+{
+  if(!m_header) return;
+#ifdef __unix
+  munmap(m_header,m_size);
+#endif
+  m_header = NULL;
+  m_size = 0;
+}
+
+ShmRing::Reader::Status ShmRing::Reader::next(const void*& data,Slot& info)
+{
+  if(atomicLoad(&m_header->closed))
+    return Closed;
+  unsigned long long written = atomicLoad(&m_header->write_count);
+  if(m_next >= written)
+    return NotReady;
+
+  // too slow, skip to the oldest frame still in the ring
+  unsigned long long nb_slots = m_header->nb_slots;
+  if(written - m_next > nb_slots)
+    {
+      m_nb_overruns += written - nb_slots - m_next;
+      m_next = written - nb_slots;
+      return Overrun;
+    }
+
+  unsigned int index = (unsigned int)(m_next % nb_slots);
+  const Slot* slot = (const Slot*)((const char*)m_header + m_header->slots_offset) + index;
+  unsigned long long sequence = atomicLoad(&slot->sequence);
+  if(sequence != 2 * m_next + 2)
+    {
+      ++m_nb_overruns;
+      ++m_next;
+      return Overrun;
+    }
+  info.frame_nb = slot->frame_nb;
+  info.timestamp = slot->timestamp;
+  info.camera_timestamp = slot->camera_timestamp;
+  info.sequence = sequence;
+  data = (const char*)m_header + m_header->data_offset + index * m_header->slot_size;
+  m_slot = slot;
+  m_sequence = sequence;
+  ++m_next;
+  return Ok;
+}
+
+bool ShmRing::Reader::validate() const
+{
+  if(!m_slot)
+    return false;
+  // the frame reads must be done before the sequence is read again
+  atomicReadFence();
+  return atomicLoad(&m_slot->sequence) == m_sequence;
+}
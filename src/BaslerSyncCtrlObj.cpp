@@ -115,6 +115,8 @@ bool SyncCtrlObj::checkAutoExposureMode(HwSyncCtrlObj::AutoExposureMode mode) co
 {
   DEB_MEMBER_FUNCT();
   DEB_PARAM() << DEB_VAR1(mode);
+  AutoMutex aDeviceLock(m_cam.m_device_lock);
+  m_cam._checkCamera();
   bool checkFlag = mode == HwSyncCtrlObj::ON ?
     GenApi::IsAvailable(m_cam.Camera_->ExposureAuto) : true;
   DEB_RETURN() << DEB_VAR1(checkFlag);
@@ -125,6 +127,8 @@ void SyncCtrlObj::setHwAutoExposureMode(AutoExposureMode mode)
 {
   DEB_MEMBER_FUNCT();
   DEB_PARAM() << DEB_VAR1(mode);
+  AutoMutex aDeviceLock(m_cam.m_device_lock);
+  m_cam._checkCamera();
   try
     {
        if ( GenApi::IsAvailable(m_cam.Camera_->ExposureAuto ))
@@ -0,0 +1,82 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "BaslerTraceRing.h"
+
+using namespace lima;
+using namespace lima::Basler;
+
+TraceRing::TraceRing() :
+  m_slots(NULL),
+  m_mask(0),
+  m_write_index(0)
+{
+}
+
+TraceRing::~TraceRing()
+{
+  delete [] m_slots;
+}
+
+void TraceRing::setSize(int nb_events)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_events);
+  if(nb_events < 0)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_events);
+
+  unsigned long long size = 0;
+  if(nb_events)
+    for(size = 1;size < (unsigned long long)nb_events;size <<= 1);
+
+  delete [] m_slots;
+  m_slots = size ? new Slot[size] : NULL;
+  m_mask = size ? size - 1 : 0;
+  reset();
+}
+
+void TraceRing::reset()
+{
+  for(unsigned long long i = 0;m_slots && i <= m_mask;++i)
+    m_slots[i].sequence = 0;
+  atomicStore(&m_write_index,0);
+}
+
+void TraceRing::read(std::vector<Event>& events) const
+{
+  events.clear();
+  if(!m_slots)
+    return;
+  unsigned long long write_index = atomicLoad(&m_write_index);
+  unsigned long long size = m_mask + 1;
+  unsigned long long index = write_index > size ? write_index - size : 0;
+  events.reserve(size_t(write_index - index));
+  for(;index < write_index;++index)
+    {
+      const Slot& slot = m_slots[index & m_mask];
+      if(atomicLoad(&slot.sequence) != 2 * index + 2)
+	continue;		// being written or already overwritten
+      Event event = slot.event;
+      atomicReadFence();
+      if(atomicLoad(&slot.sequence) == 2 * index + 2)
+	events.push_back(event);
+    }
+}
@@ -61,6 +61,8 @@ void VideoCtrlObj::getSupportedVideoMode(std::list<VideoMode>& aList) const
       {"Mono8",Y8},
       {NULL,Y8}
     };
+  AutoMutex aDeviceLock(m_cam.m_device_lock);
+  m_cam._checkCamera();
   for(const _VideoMode* pt = BaslerVideoMode;pt->stringMode;++pt)
     {
       GenApi::IEnumEntry *anEntry = 
@@ -72,6 +74,8 @@ void VideoCtrlObj::getSupportedVideoMode(std::list<VideoMode>& aList) const
 void VideoCtrlObj::getVideoMode(VideoMode &mode) const
 {
   DEB_MEMBER_FUNCT();
+  AutoMutex aDeviceLock(m_cam.m_device_lock);
+  m_cam._checkCamera();
 
   PixelFormatEnums aCurrentPixelFormat = m_cam.Camera_->PixelFormat.GetValue();
   switch(aCurrentPixelFormat)
@@ -155,6 +159,8 @@ void VideoCtrlObj::setVideoMode(VideoMode mode)
     default:
       THROW_HW_ERROR(NotSupported) << "Mode type not supported yet";
     }
+  AutoMutex aDeviceLock(m_cam.m_device_lock);
+  m_cam._checkCamera();
   m_cam._freeStreamGrabber();
   bool succeed = false;
   std::string errorMsg;
@@ -209,6 +215,8 @@ void VideoCtrlObj::checkBin(Bin &bin)
 
 void VideoCtrlObj::checkRoi(const Roi&,Roi& hw_roi)
 {
+  AutoMutex aDeviceLock(m_cam.m_device_lock);
+  m_cam._checkCamera();
   hw_roi = Roi(0,0,
 	       m_cam.Camera_->Width.GetMax(),
 	       m_cam.Camera_->Height.GetMax());
@@ -216,8 +224,10 @@ void VideoCtrlObj::checkRoi(const Roi&,Roi& hw_roi)
 
 bool VideoCtrlObj::checkAutoGainMode(AutoGainMode mode) const
 {
-  return mode == OFF ? true :
-    GenApi::IsAvailable(m_cam.Camera_->GainAuto) && 
+  if(mode == OFF) return true;
+  AutoMutex aDeviceLock(m_cam.m_device_lock);
+  m_cam._checkCamera();
+  return GenApi::IsAvailable(m_cam.Camera_->GainAuto) && 
     GenApi::IsAvailable(m_cam.Camera_->GainSelector);
 }
 
@@ -0,0 +1,137 @@
+//###########################################################################
+// This file is part of LImA, a Library for Image Acquisition
+//
+// Copyright (C) : 2009-2011
+// European Synchrotron Radiation Facility
+// BP 220, Grenoble 38043
+// FRANCE
+//
+// This is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 3 of the License, or
+// (at your option) any later version.
+//
+// This software is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, see <http://www.gnu.org/licenses/>.
+//###########################################################################
+#include "BaslerWorkerPool.h"
+
+using namespace lima;
+using namespace lima::Basler;
+
+class WorkerPool::_Worker : public Thread
+{
+  DEB_CLASS_NAMESPC(DebModCamera, "WorkerPool", "_Worker");
+public:
+  _Worker(WorkerPool& pool,int part,int generation) :
+    m_pool(pool),m_part(part),m_generation(generation) {}
+  virtual ~_Worker() {join();}
+
+protected:
+  virtual void threadFunction();
+
+private:
+  WorkerPool&	m_pool;
+  int		m_part;
+  int		m_generation;	// last generation processed
+};
+
+void WorkerPool::_Worker::threadFunction()
+{
+  DEB_MEMBER_FUNCT();
+  AutoMutex aLock(m_pool.m_cond.mutex());
+  int generation = m_generation;
+  while(true)
+    {
+      while(generation == m_pool.m_generation && !m_pool.m_quit)
+	m_pool.m_cond.wait();
+      if(m_pool.m_quit) break;
+
+      generation = m_pool.m_generation;
+      Task* task = m_pool.m_task;
+      int nb_parts = int(m_pool.m_workers.size()) + 1;
+      aLock.unlock();
+      task->process(m_part,nb_parts);
+      aLock.lock();
+      if(!--m_pool.m_pending)
+	m_pool.m_cond.broadcast();
+    }
+}
+
+WorkerPool::WorkerPool() :
+  m_nb_threads(1),
+  m_task(NULL),
+  m_generation(0),
+  m_pending(0),
+  m_quit(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+  _stopWorkers();
+}
+
+void WorkerPool::setNbThreads(int nb_threads)
+{
+  DEB_MEMBER_FUNCT();
+  DEB_PARAM() << DEB_VAR1(nb_threads);
+  if(nb_threads < 1)
+    THROW_HW_ERROR(InvalidValue) << "Invalid " << DEB_VAR1(nb_threads);
+  if(nb_threads == m_nb_threads) return;
+  _stopWorkers();
+  m_nb_threads = nb_threads;
+}
+
+void WorkerPool::run(Task& task)
+{
+  if(int(m_workers.size()) + 1 < m_nb_threads)
+    _startWorkers();
+
+  int nb_parts = int(m_workers.size()) + 1;
+  if(nb_parts > 1)
+    {
+      AutoMutex aLock(m_cond.mutex());
+      m_task = &task;
+      m_pending = nb_parts - 1;
+      ++m_generation;
+      m_cond.broadcast();
+    }
+  task.process(0,nb_parts);
+  if(nb_parts > 1)
+    {
+      AutoMutex aLock(m_cond.mutex());
+      while(m_pending)
+	m_cond.wait();
+      m_task = NULL;
+    }
+}
+
+void WorkerPool::_startWorkers()
+{
+  DEB_MEMBER_FUNCT();
+  for(int part = int(m_workers.size()) + 1;part < m_nb_threads;++part)
+    {
+      _Worker* worker = new _Worker(*this,part,m_generation);
+      worker->start();
+      AutoMutex aLock(m_cond.mutex());
+      m_workers.push_back(worker);
+    }
+}
+
+void WorkerPool::_stopWorkers()
+{
+  AutoMutex aLock(m_cond.mutex());
+  m_quit = true;
+  m_cond.broadcast();
+  aLock.unlock();
+  for(std::vector<_Worker*>::iterator i = m_workers.begin();i != m_workers.end();++i)
+    delete *i;
+  m_workers.clear();
+  m_quit = false;
+}